@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CONFIG_SPEC_H__
+#define __CONFIG_SPEC_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * "key=value,..." option strings of the environment variables
+ *
+ * Every key is looked up in a table of options. The handler of the option parses the value
+ * into its field of the config object and returns false when the value is invalid.
+ * Unknown keys, keys without a value and invalid values are logged and stop the parsing.
+ */
+
+typedef bool (*config_spec_handler)(void *field, const char *value);
+
+typedef struct {
+	const char			*key;
+	config_spec_handler	handler;
+	size_t				offset;		// offset of the field in the config object
+} config_spec_option_t;
+
+#define CONFIG_SPEC_OPTION(key, handler, type, field)	{ key, handler, offsetof(type, field) }
+
+/*
+ * parse spec into config, name prefixes the log messages ("<name> option ...")
+ * a NULL or empty spec leaves config as it is, returns false on the first invalid option
+ */
+bool config_spec_parse(const char *spec, const char *name,
+		const config_spec_option_t *options, size_t n_options, void *config);
+
+// unsigned int field, decimal
+bool config_spec_uint(void *field, const char *value);
+
+// double field
+bool config_spec_double(void *field, const char *value);
+
+// bool enabled field, "off=1" disables, "off=0" enables
+bool config_spec_off(void *field, const char *value);
+
+#endif /* __CONFIG_SPEC_H__ */
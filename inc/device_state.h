@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DEVICE_STATE_H__
+#define __DEVICE_STATE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "resource/resource_pms7003_sensor.h"
+#include "rolling_stats.h"
+
+// latest reading of one sensor, as received
+typedef struct {
+	_concentration_unit_t	standard_particle;	// CF=1，standard particle
+	uint64_t				arrival_ms;			// CLOCK_MONOTONIC milliseconds the reading was received, 0 : none yet
+} device_sensor_state_t;
+
+/*
+ * Device state : latest PM values, fan speed and power switch
+ * published through a seqlock, readers get a consistent snapshot without locking
+ * and never hold up the writer. Writers are serialized among themselves.
+ */
+typedef struct {
+	uint32_t				version;			// incremented on every update
+	_concentration_unit_t	standard_particle;	// CF=1，standard particle
+	_concentration_unit_t	atmospheric_env;	// under atmospheric environment
+	_particle_count_t		particle_count;		// particle count per 0.1 L
+	rolling_stats_result_t	fine_dust_stats;	// PM2.5 rolling statistics
+	rolling_stats_result_t	dust_stats;			// PM10 rolling statistics
+	uint64_t				arrival_ms;			// CLOCK_MONOTONIC milliseconds the sample was received, 0 : none yet
+	device_sensor_state_t	sensors[PMS7003_SENSOR_MAX];	// every sensor as received, the values above are the published ones
+	uint32_t				fan_speed;			// manual 0x01 ~ 0x04, auto 0x11 ~ 0x14
+	bool					switch_status;		// power switch on / off
+} device_state_t;
+
+void device_state_init(uint32_t fan_speed, bool switch_status);
+
+// consistent copy of the whole state, lock-free
+void device_state_get(device_state_t *snapshot);
+
+// milliseconds since arrival_ms (CLOCK_MONOTONIC) of a snapshot, -1 if there is no sample yet (0)
+int64_t device_state_age_ms(uint64_t arrival_ms);
+
+// published reading and the rolling statistics including it, in one update
+void device_state_set_sensor(const _pms7003_protocol_t *frame,
+		const rolling_stats_result_t *fine_dust, const rolling_stats_result_t *dust);
+void device_state_set_sensor_reading(int sensor, const _pms7003_protocol_t *frame);
+void device_state_set_fan_speed(uint32_t fan_speed);
+void device_state_set_switch(bool switch_status);
+
+#endif /* __DEVICE_STATE_H__ */
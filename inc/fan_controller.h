@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FAN_CONTROLLER_H__
+#define __FAN_CONTROLLER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Table-driven fan tier controller with hysteresis and dwell time
+ *
+ * The table lists the tiers from the lowest up. A tier is entered from below when the
+ * input rises above its up threshold and left downwards when the input falls to its
+ * down threshold or lower, down < up gives the hysteresis band. The first tier has no
+ * thresholds. Once the controller changed the tier, its next change waits dwell seconds.
+ *
+ * Configured from a "key=value,..." string, e.g. "input=ewma,dwell=30"
+ *   input : raw | ewma | median | mean10s, reading the controller acts on
+ *   dwell : minimum seconds in a tier
+ */
+
+typedef enum {
+	FAN_INPUT_RAW = 0,
+	FAN_INPUT_EWMA,
+	FAN_INPUT_MEDIAN,
+	FAN_INPUT_MEAN_10S,
+} fan_input_e;
+
+typedef struct {
+	uint32_t	fan_speed;	// value set when the tier is active
+	uint32_t	up;			// enter from below when input > up
+	uint32_t	down;		// leave downwards when input <= down
+} fan_controller_tier_t;
+
+typedef struct {
+	fan_input_e		input;
+	unsigned int	dwell;	// seconds
+} fan_controller_config_t;
+
+typedef struct {
+	uint32_t	changes;
+	uint32_t	held;		// updates that wanted a change within the dwell time
+} fan_controller_stats_t;
+
+typedef struct {
+	const fan_controller_tier_t	*tiers;
+	int							n_tiers;
+	fan_controller_config_t		config;
+	uint32_t					fan_speed;		// last speed seen or set
+	uint32_t					changed_sec;	// monotonic seconds of the last tier change
+	bool						started;
+	fan_controller_stats_t		stats;
+} fan_controller_t;
+
+void fan_controller_config_default(fan_controller_config_t *config);
+bool fan_controller_parse_config(const char *spec, fan_controller_config_t *config);
+
+void fan_controller_init(fan_controller_t *ctl, const fan_controller_tier_t *tiers, int n_tiers,
+		const fan_controller_config_t *config);
+
+/*
+ * fan speed for input at now_sec (monotonic seconds), given the current fan speed
+ * the dwell time applies between changes of the controller only, the first update and an update
+ * after a speed the controller did not set (e.g. back from manual mode) may change the tier at once
+ */
+uint32_t fan_controller_update(fan_controller_t *ctl, uint32_t now_sec, uint32_t input, uint32_t fan_speed);
+
+void fan_controller_get_stats(const fan_controller_t *ctl, fan_controller_stats_t *stats);
+
+#endif /* __FAN_CONTROLLER_H__ */
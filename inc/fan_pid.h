@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FAN_PID_H__
+#define __FAN_PID_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Fixed-point PID loop from PM2.5 to fan duty (0 ~ 1000 permille)
+ *
+ * Experimental, used by auto mode only when PMS7003_FAN_PID is set. The default gains are
+ * not tuned against the simulator : on a simulated day the loop spent about 20 % more fan
+ * energy than the tier table (fan_controller.h).
+ *
+ * error = PM2.5 - setpoint, a positive error speeds the fan up.
+ * duty  = Kp * error + integral(Ki * error dt) - Kd * d(PM2.5)/dt
+ * The derivative acts on the measurement so setpoint changes do not kick the fan.
+ * Anti-windup : the integral is clamped to the duty range and is not integrated
+ * further while the output saturates in the direction of the error.
+ *
+ * Gains are kept in thousandths (permille of duty per ug/m3, per ug/m3 s, per ug/m3/s),
+ * the integral in thousandths of permille.
+ *
+ * Configured from a "key=value,..." string, e.g. "setpoint=12,kp=20,ki=0.5,kd=0"
+ *   setpoint : target PM2.5, ug/m3
+ *   kp       : permille of duty per ug/m3 of error
+ *   ki       : permille of duty per ug/m3 of error and second
+ *   kd       : permille of duty per ug/m3/s of PM2.5 change
+ */
+
+#define FAN_PID_DUTY_MAX	1000	// permille
+
+typedef struct {
+	unsigned int	setpoint;
+	int32_t			kp_milli;
+	int32_t			ki_milli;
+	int32_t			kd_milli;
+} fan_pid_config_t;
+
+typedef struct {
+	fan_pid_config_t	config;
+	int64_t				integral;		// permille * 1000
+	uint32_t			last_input;
+	uint64_t			last_ms;		// monotonic milliseconds of the previous update
+	bool				started;
+	uint32_t			duty;			// permille
+} fan_pid_t;
+
+void fan_pid_config_default(fan_pid_config_t *config);
+bool fan_pid_parse_config(const char *spec, fan_pid_config_t *config);
+
+void fan_pid_init(fan_pid_t *pid, const fan_pid_config_t *config);
+
+/*
+ * restart the loop, e.g. when auto mode is entered again after manual mode
+ * the next update does not integrate over the time the loop was not updated
+ */
+void fan_pid_reset(fan_pid_t *pid);
+
+// duty for PM2.5 input at now_ms (monotonic milliseconds)
+uint32_t fan_pid_update(fan_pid_t *pid, uint64_t now_ms, uint32_t input);
+
+/*
+ * map duty onto one of levels steps (0 ~ levels - 1) around the current step,
+ * a step changes only when the duty is a quarter step past the boundary
+ */
+int fan_pid_level(uint32_t duty, int current, int levels);
+
+#endif /* __FAN_PID_H__ */
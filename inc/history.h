@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "resource/resource_pms7003_sensor.h"
+
+/*
+ * Fixed-footprint multi-resolution history of PM readings
+ *
+ * Tier     Bucket   Depth           Entry      Size
+ * second   1 s      3600 (1 hour)   12 bytes   43,200 bytes
+ * minute   1 min    1440 (1 day)    32 bytes   46,080 bytes
+ * hour     1 hour   744 (31 days)   32 bytes   23,808 bytes
+ *
+ * Memory ceiling : 113,088 bytes of static storage plus one open bucket per aggregate tier,
+ * nothing is allocated at run time. Each reading updates the second tier and the open minute
+ * and hour buckets in O(1), a bucket is pushed into its ring when the next bucket starts.
+ * Times are UTC seconds (time(NULL)).
+ */
+
+#define HISTORY_SECOND_DEPTH	3600
+#define HISTORY_MINUTE_DEPTH	1440
+#define HISTORY_HOUR_DEPTH		744
+
+#define HISTORY_PM_CHANNELS		3	// PM1.0, PM2.5, PM10
+
+typedef enum {
+	HISTORY_RES_SECOND = 0,
+	HISTORY_RES_MINUTE,
+	HISTORY_RES_HOUR,
+	HISTORY_RES_MAX,
+} history_resolution_e;
+
+typedef struct {
+	uint16_t	min;
+	uint16_t	max;
+	uint32_t	sum;	// mean = sum / count
+} history_stat_t;
+
+typedef struct {
+	uint32_t		time;		// bucket start, UTC seconds
+	uint16_t		count;		// number of readings in the bucket
+	history_stat_t	pm[HISTORY_PM_CHANNELS];	// PM1.0, PM2.5, PM10
+} history_aggregate_t;
+
+typedef struct {
+	uint32_t	time;
+	uint16_t	pm[HISTORY_PM_CHANNELS];
+} history_sample_t;
+
+/*
+ * called on the writer thread with every bucket pushed into the minute or hour ring
+ */
+typedef void (*history_bucket_cb)(history_resolution_e res, const history_aggregate_t *bucket);
+
+void history_init(void);
+void history_set_bucket_cb(history_bucket_cb bucket_cb);
+
+// add one reading (standard particle, CF=1) taken at time
+void history_add(uint32_t time, const _concentration_unit_t *pm);
+
+/*
+ * copy the buckets of resolution res overlapping [start, end] into out, oldest first
+ * the open bucket of the tier is included, second samples are returned with count 1
+ * returns the number of buckets copied, at most max
+ */
+size_t history_query(history_resolution_e res, uint32_t start, uint32_t end, history_aggregate_t *out, size_t max);
+
+// bucket width of a resolution in seconds
+uint32_t history_resolution_seconds(history_resolution_e res);
+
+#endif /* __HISTORY_H__ */
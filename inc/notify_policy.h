@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NOTIFY_POLICY_H__
+#define __NOTIFY_POLICY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Change-based observer notification
+ *
+ * A notification is sent when
+ *   - nothing was sent yet (or the policy was reset), or
+ *   - heartbeat seconds passed since the last one, or
+ *   - min_interval seconds passed and any value moved out of the deadband around the
+ *     value last sent : |value - sent| > max(abs, sent * rel / 100)
+ * Everything else is suppressed and counted.
+ *
+ * Configured from a "key=value,..." string, e.g. "abs=2,rel=10,min=5,heartbeat=60"
+ *   abs       : absolute deadband, ug/m3
+ *   rel       : relative deadband, percent of the value last sent
+ *   min       : minimum seconds between notifications
+ *   heartbeat : maximum seconds between notifications, 0 never forces one
+ *   off       : "off=1" notifies on every call, as before
+ */
+
+#define NOTIFY_POLICY_VALUES	3
+
+typedef struct {
+	bool			enabled;
+	unsigned int	abs_deadband;
+	unsigned int	rel_deadband;	// percent
+	unsigned int	min_interval;	// seconds
+	unsigned int	heartbeat;		// seconds
+} notify_policy_config_t;
+
+typedef struct {
+	uint32_t	sent;
+	uint32_t	suppressed;
+	uint32_t	heartbeats;		// sent because of the heartbeat only
+} notify_policy_stats_t;
+
+typedef struct {
+	notify_policy_config_t	config;
+	bool					has_sent;
+	uint32_t				last_sec;
+	uint32_t				last_value[NOTIFY_POLICY_VALUES];
+	notify_policy_stats_t	stats;
+} notify_policy_t;
+
+void notify_policy_config_default(notify_policy_config_t *config);
+bool notify_policy_parse_config(const char *spec, notify_policy_config_t *config);
+
+void notify_policy_init(notify_policy_t *policy, const notify_policy_config_t *config);
+
+// next check notifies regardless of values and intervals
+void notify_policy_reset(notify_policy_t *policy);
+
+/*
+ * decide whether the current values (n <= NOTIFY_POLICY_VALUES) are to be notified at now_sec
+ * (monotonic seconds), values are remembered as sent when true is returned
+ */
+bool notify_policy_check(notify_policy_t *policy, uint32_t now_sec, const uint32_t *values, int n);
+
+void notify_policy_get_stats(const notify_policy_t *policy, notify_policy_stats_t *stats);
+
+#endif /* __NOTIFY_POLICY_H__ */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __OUTLIER_FILTER_H__
+#define __OUTLIER_FILTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "resource/resource_pms7003_sensor.h"
+#include "rolling_stats.h"
+
+/*
+ * Hampel filter on the standard particle channels (PM1.0, PM2.5, PM10)
+ *
+ * A frame is rejected when any channel is further from the median of its last
+ * window samples than max(floor, threshold * 1.4826 * MAD). Every raw value enters
+ * the window, so a real step change is accepted again after window / 2 frames.
+ * Nothing is rejected until the window is full.
+ *
+ * Configured from a "key=value,..." string, e.g. "window=7,threshold=3.0,floor=10"
+ *   window    : samples, 3 ~ ROLLING_MEDIAN_WINDOW
+ *   threshold : number of scaled MADs
+ *   floor     : smallest deviation ever rejected, ug/m3, keeps flat signals from rejecting noise
+ *   off       : "off=1" passes every frame
+ */
+
+#define OUTLIER_FILTER_CHANNELS		3
+
+typedef struct {
+	bool			enabled;
+	unsigned int	window;
+	unsigned int	threshold_x10;	// threshold * 10
+	unsigned int	floor;
+} outlier_filter_config_t;
+
+typedef struct {
+	uint32_t	accepted;
+	uint32_t	rejected;
+	uint32_t	rejected_channel[OUTLIER_FILTER_CHANNELS];	// PM1.0, PM2.5, PM10 found out of range
+} outlier_filter_stats_t;
+
+typedef struct {
+	outlier_filter_config_t	config;
+	rolling_median_t		median[OUTLIER_FILTER_CHANNELS];
+	outlier_filter_stats_t	stats;
+} outlier_filter_t;
+
+void outlier_filter_config_default(outlier_filter_config_t *config);
+bool outlier_filter_parse_config(const char *spec, outlier_filter_config_t *config);
+
+void outlier_filter_init(outlier_filter_t *filter, const outlier_filter_config_t *config);
+
+// true when the frame is to be published, the frame always updates the windows
+bool outlier_filter_check(outlier_filter_t *filter, const _pms7003_protocol_t *frame);
+
+void outlier_filter_get_stats(const outlier_filter_t *filter, outlier_filter_stats_t *stats);
+
+#endif /* __OUTLIER_FILTER_H__ */
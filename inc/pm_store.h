@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PM_STORE_H__
+#define __PM_STORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Persistent per-minute PM time series under the app data path
+ *
+ * File Format : BLOCK[n], append-only
+ * Block  : HEADER[16] + PAYLOAD[LENGTH]
+ * Header : MAGIC[2] "PB" + COUNT[2] + LENGTH[2] + CHECK[2] + FIRST_TIME[4] + LAST_TIME[4], little endian
+ * Payload : COUNT records, each one DELTA_TIME[varint] + DELTA_PM1_0[zigzag varint]
+ *           + DELTA_PM2_5[zigzag varint] + DELTA_PM10[zigzag varint]
+ *           deltas are taken from the previous record, the first one from (FIRST_TIME, 0, 0, 0)
+ * CHECK  : 16 bit sum of the payload bytes, a torn block at the end of the file is cut at open
+ *
+ * Records are batched in memory and written as one block every PM_STORE_FLUSH_RECORDS records,
+ * one flash write per hour of per-minute data. A record takes about 4 bytes, so one file of
+ * PM_STORE_FILE_MAX holds about 6 weeks. When the current file is full it becomes the previous
+ * file and a new one is started, two files are kept.
+ * Block headers are indexed in memory at open, a range query maps the files and only
+ * decodes the blocks overlapping the range.
+ */
+
+#define PM_STORE_FLUSH_RECORDS	60
+#define PM_STORE_FILE_MAX		(256 * 1024)
+
+typedef struct {
+	uint32_t	time;	// UTC seconds
+	uint16_t	pm1_0;
+	uint16_t	pm2_5;
+	uint16_t	pm10;
+} pm_store_record_t;
+
+bool pm_store_init(const char *dir);
+void pm_store_fini(void);	// flushes pending records
+
+bool pm_store_append(const pm_store_record_t *record);
+bool pm_store_flush(void);
+
+/*
+ * copy the records with start <= time <= end into out, oldest first
+ * returns the number of records copied, at most max
+ */
+size_t pm_store_query(uint32_t start, uint32_t end, pm_store_record_t *out, size_t max);
+
+#endif /* __PM_STORE_H__ */
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PMS7003_BENCH_H__
+#define __PMS7003_BENCH_H__
+
+/*
+ * PMS7003 frame decoder benchmark, built with PMS7003_BENCHMARK defined
+ * runs the legacy byte-wise state machine (baseline) and pms7003_parser_t over
+ * clean, corrupted and misaligned streams and logs the results
+ */
+void pms7003_bench_run(void);
+
+/*
+ * UART receive loop benchmark : timer polling against poll() on the UART fd,
+ * logs wakeups per minute and CPU time per decoded frame
+ * runs the termios backend on a pty only, peripheral-io has no fd and is not covered
+ */
+void pms7003_bench_io_run(void);
+
+/*
+ * passive read schedule check : the reader thread reads a virtual PMS7003 while the period is
+ * ramped up and down between two reads, logs when each next read was sent against when it was due
+ */
+void pms7003_bench_schedule_run(void);
+
+#endif /* __PMS7003_BENCH_H__ */
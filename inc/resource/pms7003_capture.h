@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PMS7003_CAPTURE_H__
+#define __PMS7003_CAPTURE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Raw UART capture file
+ * append-only, every received chunk is stored with its CLOCK_MONOTONIC arrival time
+ *
+ * File Format : HEADER[8] + RECORD[n]
+ * Header : "PMS7CAP" + version [0x01]
+ * Record : DELTA_US[varint] + LENGTH[varint] + DATA[LENGTH]
+ *   DELTA_US : microseconds since the previous record (since capture start for the first one)
+ *   LENGTH 0 : empty record written when a capture is appended to an existing file,
+ *              the next DELTA_US is relative to the start of the appended capture
+ *   varint   : unsigned LEB128, 7 bits per byte, least significant group first
+ */
+
+#define PMS7003_CAPTURE_MAGIC		"PMS7CAP"
+#define PMS7003_CAPTURE_VERSION		0x01
+#define PMS7003_CAPTURE_HEADER_SIZE	8
+#define PMS7003_CAPTURE_CHUNK_MAX	4096	// longest record accepted by the reader
+
+typedef struct {
+	FILE			*fp;
+	uint64_t		last_us;		// monotonic time of the previous record
+	unsigned int	unflushed;		// records written since the last flush
+	unsigned long	records;
+	unsigned long	bytes;
+} pms7003_capture_t;
+
+typedef struct {
+	FILE			*fp;
+	uint64_t		time_us;		// time of the last record read, relative to capture start
+	unsigned long	records;
+} pms7003_capture_reader_t;
+
+uint64_t pms7003_capture_now_us(void);
+
+// create or append to a capture file
+bool pms7003_capture_open(pms7003_capture_t *capture, const char *path);
+bool pms7003_capture_write(pms7003_capture_t *capture, const uint8_t *data, size_t len);
+void pms7003_capture_close(pms7003_capture_t *capture);
+
+bool pms7003_capture_reader_open(pms7003_capture_reader_t *reader, const char *path);
+
+/*
+ * read the next record into data (at most PMS7003_CAPTURE_CHUNK_MAX bytes)
+ * *time_us is the record time relative to capture start
+ * returns false at the end of the file or on a corrupted record
+ */
+bool pms7003_capture_reader_next(pms7003_capture_reader_t *reader, uint64_t *time_us, uint8_t *data, size_t *len);
+void pms7003_capture_reader_close(pms7003_capture_reader_t *reader);
+
+#endif /* __PMS7003_CAPTURE_H__ */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PMS7003_PARSER_H__
+#define __PMS7003_PARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "resource/resource_pms7003_sensor.h"
+
+#define PMS7003_FRAME_SIZE		32	// START_CHAR1 + START_CHAR2 + FRAME_LENGTH[2] + DATA[2 x 13] + CHECKSUM[2]
+#define PMS7003_START_CHAR1		0x42
+#define PMS7003_START_CHAR2		0x4D
+#define PMS7003_DATA_FRAME_LEN	(PMS7003_FRAME_SIZE - 4)	// value of the FRAME_LENGTH field : 2 x 13 + 2
+
+// command response : START_CHAR1 + START_CHAR2 + FRAME_LENGTH[2] + CMD[1] + DATA[1] + CHECKSUM[2]
+#define PMS7003_RESPONSE_FRAME_SIZE	8
+#define PMS7003_RESPONSE_FRAME_LEN	(PMS7003_RESPONSE_FRAME_SIZE - 4)
+
+/*
+ * host commands : START_CHAR1 + START_CHAR2 + CMD[1] + DATAH[1] + DATAL[1] + LRC[2]
+ * LRC = START_CHAR1 + START_CHAR2 + CMD + DATAH + DATAL
+ */
+#define PMS7003_COMMAND_SIZE		7
+#define PMS7003_CMD_READ			0xE2	// passive mode read, answered by a data frame
+#define PMS7003_CMD_MODE			0xE1	// data PMS7003_MODE_PASSIVE / PMS7003_MODE_ACTIVE
+#define PMS7003_CMD_SLEEP			0xE4	// data PMS7003_SLEEP / PMS7003_WAKEUP
+#define PMS7003_MODE_PASSIVE		0x00
+#define PMS7003_MODE_ACTIVE			0x01
+#define PMS7003_SLEEP				0x00
+#define PMS7003_WAKEUP				0x01	// not answered, the sensor restarts its fan
+
+/*
+ * Reentrant streaming PMS7003 frame parser
+ * All state lives in the parser object, so several parsers can run at once.
+ * Data frames and 8 byte command responses are decoded, a response has frame_len
+ * PMS7003_RESPONSE_FRAME_LEN and carries response_cmd / response_data.
+ * The parser keeps a sliding window of at most one frame. When the window turns out
+ * not to be a frame (bad length or checksum) it drops the first byte and rescans the
+ * bytes already buffered for the next start characters, so a corrupted byte costs one frame.
+ */
+typedef struct {
+	uint8_t			window[PMS7003_FRAME_SIZE];	// bytes of the frame candidate
+	unsigned int	window_len;					// number of bytes in window
+
+	// statistics
+	unsigned long	frames;				// valid frames decoded
+	unsigned long	checksum_errors;	// candidates dropped on checksum mismatch
+	unsigned long	length_errors;		// candidates dropped on invalid FRAME_LENGTH
+	unsigned long	discarded_bytes;	// bytes skipped while searching for a frame
+	unsigned long	scan_steps;			// window checks and bytes moved, bounds the cost per input byte
+} pms7003_parser_t;
+
+void pms7003_parser_init(pms7003_parser_t *parser);
+
+/*
+ * feed n received bytes to the parser
+ * decoded frames are stored into frames[], at most max_frames
+ * parsing stops once max_frames are decoded, *consumed is set to the number of bytes used
+ * a complete frame left buffered behind the last one is returned by the next call, even with n = 0,
+ * so *consumed can be 0 when frames are returned
+ * returns the number of decoded frames
+ */
+size_t pms7003_parser_feed(pms7003_parser_t *parser, const uint8_t *bytes, size_t n,
+		_pms7003_protocol_t *frames, size_t max_frames, size_t *consumed);
+
+// drop a partially received frame, statistics are kept
+void pms7003_parser_reset(pms7003_parser_t *parser);
+
+// encode a host command into buf (PMS7003_COMMAND_SIZE bytes), returns the command size
+size_t pms7003_encode_command(uint8_t cmd, uint16_t data, uint8_t *buf);
+
+#endif /* __PMS7003_PARSER_H__ */
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PMS7003_SIMULATOR_H__
+#define __PMS7003_SIMULATOR_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "resource/resource_pms7003_sensor.h"
+#include "resource/pms7003_parser.h"
+
+#define PMS7003_SIM_PATH_MAX	64
+
+// PM2.5 concentration profile over simulated time
+typedef enum {
+	PMS7003_SIM_PROFILE_CONSTANT = 0,	// base
+	PMS7003_SIM_PROFILE_WAVE,			// triangle wave between base and base + amplitude
+	PMS7003_SIM_PROFILE_STEP,			// base for half a period, then base + amplitude
+	PMS7003_SIM_PROFILE_RAMP,			// from base to base + amplitude over a period
+	PMS7003_SIM_PROFILE_RANDOM_WALK,	// random steps of up to amplitude / 10 within [0, base + amplitude]
+} pms7003_sim_profile_e;
+
+typedef struct {
+	pms7003_sim_profile_e	profile;
+	unsigned int	base;				// PM2.5 base concentration, ug/m3
+	unsigned int	amplitude;			// PM2.5 profile amplitude, ug/m3
+	unsigned int	period_ms;			// profile period in simulated time
+	unsigned int	spike_permille;		// frames carrying a one-frame spike of 4 x (base + amplitude)
+	unsigned int	noise_per_10000;	// bytes with flipped bits per 10000 bytes
+	unsigned int	truncate_permille;	// frames cut short
+	unsigned int	checksum_permille;	// frames sent with a wrong checksum
+	double			speed;				// time scale : 1.0 real time, 10.0 ten times faster, 0 as fast as possible
+	unsigned int	seed;				// random seed, runs are reproducible
+} pms7003_sim_config_t;
+
+/*
+ * Virtual PMS7003 : writes active mode frames into the master side of a pseudo-terminal
+ * The driver opens slave_path through the termios transport.
+ * Host commands written to the slave are answered like the sensor does : passive / active
+ * mode, passive read and sleep / wake up.
+ */
+typedef struct {
+	pms7003_sim_config_t	config;
+	int				master_fd;
+	char			slave_path[PMS7003_SIM_PATH_MAX];
+	pthread_t		thread;
+	bool			running;
+	bool			stop;
+
+	// simulation state
+	unsigned int	rand_state;
+	uint64_t		sim_time_ms;
+	unsigned int	last_pm2_5;
+	bool			passive;		// frames are sent on read commands only
+	bool			sleeping;		// no frames until wake up
+	uint8_t			cmd_buf[PMS7003_COMMAND_SIZE];
+	unsigned int	cmd_len;
+
+	// statistics
+	unsigned long	frames_sent;
+	unsigned long	fast_mode_frames;
+	unsigned long	spikes;
+	unsigned long	corrupted_bytes;
+	unsigned long	truncated_frames;
+	unsigned long	checksum_errors;
+	unsigned long	commands;
+	unsigned long	reads;			// passive read commands answered
+	uint64_t		last_read_us;	// CLOCK_MONOTONIC time of the last one
+} pms7003_simulator_t;
+
+void pms7003_simulator_config_default(pms7003_sim_config_t *config);
+
+/*
+ * parse a comma separated key=value list into config, unknown keys are rejected
+ * keys : profile=constant|wave|step|ramp|walk, base, amp, period (ms), spike (permille),
+ *        noise (per 10000 bytes), trunc (permille), cksum (permille), speed, seed
+ */
+bool pms7003_simulator_parse_config(const char *spec, pms7003_sim_config_t *config);
+
+bool pms7003_simulator_start(pms7003_simulator_t *sim, const pms7003_sim_config_t *config);
+void pms7003_simulator_stop(pms7003_simulator_t *sim);
+
+// encode frame into a valid 32 byte active mode frame, frame_len and checksum are computed
+void pms7003_simulator_encode(const _pms7003_protocol_t *frame, uint8_t *buf);
+
+// fill frame with plausible values for the given PM2.5 concentration
+void pms7003_simulator_make_frame(unsigned int pm2_5, _pms7003_protocol_t *frame);
+
+#endif /* __PMS7003_SIMULATOR_H__ */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RESOURCE_PMS7003_READER_H__
+#define __RESOURCE_PMS7003_READER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "resource/resource_pms7003_sensor.h"
+
+/*
+ * callback invoked on the Ecore main loop for every frame decoded by the reader thread
+ * sensor is the id of the sensor that sent the frame, 0 ~ resource_pms7003_count() - 1
+ */
+typedef void (*pms7003_frame_cb)(int sensor, const _pms7003_protocol_t *frame, void *user_data);
+
+bool resource_pms7003_reader_start(pms7003_frame_cb frame_cb, void *user_data);
+void resource_pms7003_reader_stop(void);
+
+/*
+ * passive mode : the reader requests one frame every period_ms instead of listening to the
+ * active mode stream, 0 selects active mode. Applied by the reader thread before its next read,
+ * if a sensor does not answer the mode command the reader keeps listening to all in active mode.
+ */
+void resource_pms7003_reader_set_period(unsigned int period_ms);
+
+/*
+ * passive mode : put the sensors to sleep between reads further apart than the warm-up time,
+ * they are woken warmup_ms before the next read. 0 keeps the sensors running.
+ */
+void resource_pms7003_reader_set_sleep(unsigned int warmup_ms);
+
+/*
+ * active mode : frames a sensor sent while the main loop was behind are not replayed one by one
+ *   PMS7003_DRAIN_OFF     : every decoded frame is delivered
+ *   PMS7003_DRAIN_LATEST  : only the newest frame received so far is delivered
+ *   PMS7003_DRAIN_AVERAGE : the newest frame, concentrations and counts averaged over the skipped ones
+ */
+typedef enum {
+	PMS7003_DRAIN_OFF = 0,
+	PMS7003_DRAIN_LATEST,
+	PMS7003_DRAIN_AVERAGE,
+} pms7003_drain_e;
+
+void resource_pms7003_reader_set_drain(pms7003_drain_e mode);
+
+// age of the delivered frames, from the UART read of their last bytes to the frame callback
+typedef struct {
+	uint32_t	delivered;		// frames passed to the frame callback
+	uint32_t	merged;			// frames folded into a newer one, not delivered
+	uint32_t	last_age_ms;
+	uint32_t	max_age_ms;
+	uint64_t	total_age_ms;	// mean age : total_age_ms / delivered
+} pms7003_reader_stats_t;
+
+// must be called from the main loop
+void resource_pms7003_reader_get_stats(pms7003_reader_stats_t *stats);
+
+#endif /* __RESOURCE_PMS7003_READER_H__ */
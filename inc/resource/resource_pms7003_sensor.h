@@ -14,6 +14,13 @@
  * limitations under the License.
  */
 
+#ifndef __RESOURCE_PMS7003_SENSOR_H__
+#define __RESOURCE_PMS7003_SENSOR_H__
+
+#include <stdint.h>
+
+#define PMS7003_SENSOR_MAX	4	// sensors on separate UART ports, numbered 0 ~ PMS7003_SENSOR_MAX - 1
+
 // concentration unit for PM data
 typedef struct {
 	uint16_t	PM1_0;	// PM1.0 concentration unit μ g/m3
@@ -21,11 +28,32 @@ typedef struct {
 	uint16_t	PM10;	// PM10 concentration unit μ g/m3
 } _concentration_unit_t;
 
-// PMS7003 transport protocol-Active Mode : 32 Bytes
+// number of particles beyond diameter in 0.1 L of air
+typedef struct {
+	uint16_t	PC0_3;	// beyond 0.3 um
+	uint16_t	PC0_5;	// beyond 0.5 um
+	uint16_t	PC1_0;	// beyond 1.0 um
+	uint16_t	PC2_5;	// beyond 2.5 um
+	uint16_t	PC5_0;	// beyond 5.0 um
+	uint16_t	PC10;	// beyond 10 um
+} _particle_count_t;
+
+/*
+ * PMS7003 transport protocol-Active Mode : 32 Bytes
+ * command response (passive mode, sleep) : 8 Bytes, frame_len 4, response_cmd / response_data set
+ */
 typedef struct {
 	unsigned char			frame_header[2];	// Fixed : start char 1 [0x42] + start char 2 [0x4d]
 	uint16_t				frame_len;			// 2 BYTE : Frame length=2x13+2(data+check bytes)
-	_concentration_unit_t	standard_particle;	// CF=1，standard particle
-	_concentration_unit_t	atmospheric_env;	// under atmospheric environment
+	_concentration_unit_t	standard_particle;	// CF=1，standard particle [data1 ~ data3]
+	_concentration_unit_t	atmospheric_env;	// under atmospheric environment [data4 ~ data6]
+	_particle_count_t		particle_count;		// particle count per 0.1 L [data7 ~ data12]
+	uint8_t					version;			// data13 high 8 bits : version number
+	uint8_t					error_code;			// data13 low 8 bits : error code
 	uint16_t				checksum;			// 2 BYTE : Check code=Start character 1+ Start character 2+……..+data 13 Low 8 bits
+	uint8_t					response_cmd;		// command response : command answered
+	uint8_t					response_data;		// command response : data of the command
+	uint64_t				arrival_ms;			// CLOCK_MONOTONIC milliseconds of the UART read that completed the frame
 } _pms7003_protocol_t;
+
+#endif /* __RESOURCE_PMS7003_SENSOR_H__ */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UART_TRANSPORT_H__
+#define __UART_TRANSPORT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define UART_TRANSPORT_PATH_MAX		256
+#define UART_TRANSPORT_PENDING_MAX	64
+
+typedef struct _uart_transport_s uart_transport_t;
+
+/*
+ * UART transport operations
+ * configure sets the baud rate with 8 data bits, no parity, 1 stop bit and no flow control
+ * read returns the number of bytes read, 0 if no data is available, negative on error
+ * write returns the number of bytes written, negative on error
+ * poll waits up to timeout_ms for readable data, returns > 0 if readable, 0 on timeout, negative on error
+ */
+typedef struct {
+	const char	*name;
+	bool	(*open)(uart_transport_t *transport);
+	bool	(*configure)(uart_transport_t *transport, unsigned int baud_rate);
+	int		(*read)(uart_transport_t *transport, uint8_t *data, uint32_t length);
+	int		(*write)(uart_transport_t *transport, const uint8_t *data, uint32_t length);
+	int		(*poll)(uart_transport_t *transport, int timeout_ms);
+	void	(*close)(uart_transport_t *transport);
+} uart_transport_ops_t;
+
+struct _uart_transport_s {
+	const uart_transport_ops_t	*ops;
+
+	int		port;								// peripheral-io UART port
+	char	path[UART_TRANSPORT_PATH_MAX];		// tty device path for the termios backend, capture file for replay
+	double	speed;								// replay time scale : 1.0 recorded speed, 0 as fast as possible
+	int		fd;									// file descriptor, -1 if the backend has none
+	void	*handle;							// backend handle
+
+	// bytes already taken from the device by poll on backends without a pollable fd
+	uint8_t			pending[UART_TRANSPORT_PENDING_MAX];
+	unsigned int	pending_len;
+
+	unsigned long	device_reads;	// read calls made to the device : read() syscalls, peripheral-io HAL calls
+};
+
+// Tizen peripheral-io backend, UART port number of the board
+bool uart_transport_peripheral_create(uart_transport_t *transport, int port);
+
+// Linux termios backend, tty device path such as /dev/ttyS0 or a pseudo-terminal
+bool uart_transport_termios_create(uart_transport_t *transport, const char *path);
+
+// replay backend, feeds a capture file (see pms7003_capture.h) back as received data
+bool uart_transport_replay_create(uart_transport_t *transport, const char *path, double speed);
+
+#endif /* __UART_TRANSPORT_H__ */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ROLLING_STATS_H__
+#define __ROLLING_STATS_H__
+
+#include <stdint.h>
+
+/*
+ * Streaming statistics of one PM channel, updated once per frame
+ *
+ * EWMA          : alpha = 1 / 2^ROLLING_EWMA_SHIFT, fixed point
+ * windowed mean : 10 s, 1 min, 15 min, kept as running sums over per-second buckets,
+ *                 a bucket leaves each window when the clock passes it (amortized O(1))
+ * median        : last ROLLING_MEDIAN_WINDOW samples, sorted window with binary search,
+ *                 also usable alone with a shorter window (outlier filter)
+ *
+ * Times are seconds of a monotonic clock supplied by the caller.
+ * Memory : ~7.4 KB per channel, nothing is allocated at run time.
+ */
+
+#define ROLLING_EWMA_SHIFT			3		// alpha = 1/8
+#define ROLLING_MEDIAN_WINDOW		31		// samples, odd
+#define ROLLING_HORIZON_SECONDS		900		// longest window (15 min)
+
+typedef enum {
+	ROLLING_WINDOW_10S = 0,
+	ROLLING_WINDOW_1MIN,
+	ROLLING_WINDOW_15MIN,
+	ROLLING_WINDOW_MAX,
+} rolling_window_e;
+
+/*
+ * running median of the last size samples, size <= ROLLING_MEDIAN_WINDOW
+ * sorted holds the window in order, ring the same samples in arrival order
+ */
+typedef struct {
+	uint16_t		sorted[ROLLING_MEDIAN_WINDOW];
+	uint16_t		ring[ROLLING_MEDIAN_WINDOW];
+	unsigned int	size;
+	unsigned int	head;
+	unsigned int	count;
+} rolling_median_t;
+
+typedef struct {
+	uint32_t	sum;
+	uint32_t	count;
+} rolling_bucket_t;
+
+typedef struct {
+	uint32_t	sum;
+	uint32_t	count;
+} rolling_window_t;
+
+typedef struct {
+	uint32_t			ewma;		// value << 8
+	uint32_t			samples;
+	uint32_t			last_sec;
+	rolling_bucket_t	bucket[ROLLING_HORIZON_SECONDS];	// indexed by second % horizon
+	rolling_window_t	window[ROLLING_WINDOW_MAX];
+	rolling_median_t	median;
+} rolling_stats_t;
+
+// values rounded to ug/m3, 0 until the first sample
+typedef struct {
+	uint32_t	ewma;
+	uint32_t	mean[ROLLING_WINDOW_MAX];	// 10 s, 1 min, 15 min
+	uint32_t	median;
+	uint32_t	samples;					// samples seen since init
+} rolling_stats_result_t;
+
+void rolling_stats_init(rolling_stats_t *stats);
+void rolling_stats_add(rolling_stats_t *stats, uint32_t now_sec, uint16_t value);
+void rolling_stats_get(const rolling_stats_t *stats, rolling_stats_result_t *result);
+
+void rolling_median_init(rolling_median_t *median, unsigned int size);
+void rolling_median_add(rolling_median_t *median, uint16_t value);
+// median of the window, 0 when empty
+uint16_t rolling_median_get(const rolling_median_t *median);
+// median absolute deviation from the median of the window, O(n), 0 when empty
+uint16_t rolling_median_mad(const rolling_median_t *median);
+
+#endif /* __ROLLING_STATS_H__ */
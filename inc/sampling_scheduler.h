@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SAMPLING_SCHEDULER_H__
+#define __SAMPLING_SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Adaptive sampling interval from the dynamics of PM2.5
+ *
+ * band = max(abs, baseline * rel / 100) around the smoothed baseline (EWMA).
+ * A sample is stable when it moved less than band since the previous sample, stays within
+ * band of the baseline and the smoothed variance around the baseline is below band^2.
+ * Every stable sample doubles the interval up to max, any other sample drops it to min,
+ * so a pollution event is followed at full rate from the first sample that shows it.
+ *
+ * Configured from a "key=value,..." string, e.g. "min=1,max=60,abs=3,rel=15,sleep=30"
+ *   min, max : interval bounds, seconds
+ *   abs, rel : band, ug/m3 and percent of the baseline
+ *   sleep    : sensor warm-up seconds, the sensor sleeps between samples further apart
+ *              than that, 0 keeps it running
+ */
+
+typedef struct {
+	unsigned int	min_interval;	// seconds
+	unsigned int	max_interval;	// seconds
+	unsigned int	abs_band;		// ug/m3
+	unsigned int	rel_band;		// percent
+	unsigned int	warmup;			// seconds, 0 : no sensor sleep
+} sampling_scheduler_config_t;
+
+typedef struct {
+	uint32_t	speedups;	// drops to the minimum interval
+	uint32_t	slowdowns;	// interval doublings
+} sampling_scheduler_stats_t;
+
+typedef struct {
+	sampling_scheduler_config_t	config;
+	unsigned int				interval;	// seconds
+	bool						has_prev;
+	uint32_t					prev;
+	uint32_t					variance;	// EWMA of (sample - baseline)^2, << 4
+	sampling_scheduler_stats_t	stats;
+} sampling_scheduler_t;
+
+void sampling_scheduler_config_default(sampling_scheduler_config_t *config);
+bool sampling_scheduler_parse_config(const char *spec, sampling_scheduler_config_t *config);
+
+void sampling_scheduler_init(sampling_scheduler_t *sched, const sampling_scheduler_config_t *config);
+
+// interval in seconds until the next sample, after sample value with smoothed baseline
+unsigned int sampling_scheduler_update(sampling_scheduler_t *sched, uint32_t value, uint32_t baseline);
+
+void sampling_scheduler_get_stats(const sampling_scheduler_t *sched, sampling_scheduler_stats_t *stats);
+
+#endif /* __SAMPLING_SCHEDULER_H__ */
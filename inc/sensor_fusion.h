@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SENSOR_FUSION_H__
+#define __SENSOR_FUSION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "resource/resource_pms7003_sensor.h"
+
+/*
+ * Fusion of redundant PMS7003 readings into one frame
+ *
+ * Every sensor keeps its latest reading, a reading is current for stale ms after it was
+ * received. Each field of the fused frame is the median of the current readings of the
+ * healthy sensors, or their mean weighted by quality :
+ *   weight = 1 / ((1 + 10 * error rate) * (band + disagreement))
+ * error rate is the smoothed checksum error rate of the sensor, disagreement the smoothed
+ * distance of its PM2.5 to the median of all current readings.
+ *
+ * A sensor is left out when its disagreement is above exclude or its error rate above errors,
+ * and only while at least two other sensors are healthy, two sensors cannot outvote each other.
+ * It is taken back once both are below half of their limit. A sensor that stops sending drops out after stale ms.
+ *
+ * A fused frame is produced once every healthy current sensor reported since the previous one,
+ * or as soon as a sensor reports twice, so a slow or dead sensor never holds up the output.
+ * The work per frame is bounded by PMS7003_SENSOR_MAX.
+ *
+ * Configured from a "key=value,..." string, e.g. "method=median,stale=5000,band=5,exclude=15,errors=200"
+ *   method  : median | weighted
+ *   stale   : ms a reading stays current
+ *   band    : ug/m3, disagreement that halves the weight
+ *   exclude : ug/m3, disagreement that leaves a sensor out
+ *   errors  : permille of frames with checksum errors that leaves a sensor out
+ *   off     : "off=1" publishes sensor 0 only
+ */
+
+#define SENSOR_FUSION_FIELDS	12	// standard PM x 3, atmospheric PM x 3, particle counts x 6
+
+typedef enum {
+	SENSOR_FUSION_MEDIAN = 0,
+	SENSOR_FUSION_WEIGHTED,
+} sensor_fusion_method_e;
+
+typedef struct {
+	bool					enabled;
+	sensor_fusion_method_e	method;
+	unsigned int			stale_ms;
+	unsigned int			band;			// ug/m3
+	unsigned int			exclude;		// ug/m3
+	unsigned int			errors;			// permille
+} sensor_fusion_config_t;
+
+typedef struct {
+	uint16_t		values[SENSOR_FUSION_FIELDS];
+	uint64_t		arrival_ms;		// 0 : no reading yet
+	uint32_t		disagreement;	// EWMA of |PM2.5 - median|, << 4
+	uint32_t		error_rate;		// EWMA of checksum errors per frame, permille
+	unsigned long	frames;			// driver counters at the previous reading
+	unsigned long	checksum_errors;
+	bool			excluded;
+} sensor_fusion_sensor_t;
+
+typedef struct {
+	uint32_t	fused;			// fused frames produced
+	uint32_t	exclusions;		// sensors left out
+	uint32_t	inclusions;		// sensors taken back
+} sensor_fusion_stats_t;
+
+typedef struct {
+	sensor_fusion_config_t	config;
+	int						n_sensors;
+	sensor_fusion_sensor_t	sensors[PMS7003_SENSOR_MAX];
+	uint32_t				reported;	// bit N : sensor N reported since the last fused frame
+	sensor_fusion_stats_t	stats;
+} sensor_fusion_t;
+
+void sensor_fusion_config_default(sensor_fusion_config_t *config);
+bool sensor_fusion_parse_config(const char *spec, sensor_fusion_config_t *config);
+
+void sensor_fusion_init(sensor_fusion_t *fusion, int n_sensors, const sensor_fusion_config_t *config);
+
+/*
+ * add the reading of sensor, frames and checksum_errors are the running counters of its driver
+ * returns true and fills *fused when a fused frame is due, its arrival_ms is the one of frame
+ */
+bool sensor_fusion_update(sensor_fusion_t *fusion, int sensor, const _pms7003_protocol_t *frame,
+		unsigned long frames, unsigned long checksum_errors, _pms7003_protocol_t *fused);
+
+// true if sensor is healthy and current at now_ms (monotonic milliseconds)
+bool sensor_fusion_is_used(const sensor_fusion_t *fusion, int sensor, uint64_t now_ms);
+
+void sensor_fusion_get_stats(const sensor_fusion_t *fusion, sensor_fusion_stats_t *stats);
+
+#endif /* __SENSOR_FUSION_H__ */
@@ -16,34 +16,74 @@
 
 #include "st_things.h"
 #include "log.h"
+#include "device_state.h"
 
 static const char *PROP_DUSTLEVEL = "dustLevel";
 static const char *PROP_FINEDUSTLEVEL = "fineDustLevel";
-
-extern void get_dust_level(uint32_t *dust_level);
-extern void get_fine_dust_level(uint32_t *fine_dust_level);
+static const char *PROP_DATAAGE = "dataAge";
+static const char *PROP_PRESENT = "present";
 
 /*
- * Dust Sensor capability attributes:
+ * Dust Sensor capability attributes (x.com.st.dustlevel):
  *   fineDustLevel: PM 2.5
  *   dustLevel: PM 10
+ * Sample attributes (x.com.dignsys.dustsample):
+ *   dataAge: milliseconds since the sample was received from the sensor, absent before the first sample
+ *   present: false on /capability/dustSensor/main/N when sensor N is not configured
  */
 
-bool handle_get_request_on_resource_capability_dustsensor(st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep)
+static void _set_dust_properties(st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep,
+		const _concentration_unit_t *pm, uint64_t arrival_ms)
 {
-	// A value representation of PM 10, micrograms per cubic meter
-	uint32_t dust_level;
-
-	// A value representation of PM 2.5, micrograms per cubic meter
-	uint32_t fine_dust_level;
-
 	if (req_msg->has_property_key(req_msg, PROP_DUSTLEVEL)) {
-		get_dust_level(&dust_level);
-		resp_rep->set_int_value(resp_rep, PROP_DUSTLEVEL, dust_level);
+		// A value representation of PM 10, micrograms per cubic meter
+		resp_rep->set_int_value(resp_rep, PROP_DUSTLEVEL, pm->PM10);
 	}
 	if (req_msg->has_property_key(req_msg, PROP_FINEDUSTLEVEL)) {
-		get_fine_dust_level(&fine_dust_level);
-		resp_rep->set_int_value(resp_rep, PROP_FINEDUSTLEVEL, fine_dust_level);
+		// A value representation of PM 2.5, micrograms per cubic meter
+		resp_rep->set_int_value(resp_rep, PROP_FINEDUSTLEVEL, pm->PM2_5);
+	}
+	if (req_msg->has_property_key(req_msg, PROP_DATAAGE)) {
+		int64_t age = device_state_age_ms(arrival_ms);
+		if (age >= 0)
+			resp_rep->set_int_value(resp_rep, PROP_DATAAGE, age);
 	}
+}
+
+bool handle_get_request_on_resource_capability_dustsensor(st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep)
+{
+	// one consistent snapshot for every property of the response
+	device_state_t state;
+	device_state_get(&state);
+
+	if (req_msg->has_property_key(req_msg, PROP_PRESENT))
+		resp_rep->set_bool_value(resp_rep, PROP_PRESENT, true);
+	_set_dust_properties(req_msg, resp_rep, &state.standard_particle, state.arrival_ms);
     return true;
 }
+
+/*
+ * /capability/dustSensor/main/N : latest reading of sensor N as received, N >= 1
+ * /capability/dustSensor/main/0 publishes the filtered values that drive the fan,
+ * from sensor 0 or the fusion of all sensors
+ * device_def.json declares the resources of PMS7003_SENSOR_MAX sensors whatever is configured,
+ * the resource of a sensor that is not configured answers present = false and no levels
+ */
+bool handle_get_request_on_resource_capability_dustsensor_n(int sensor, bool present, st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep)
+{
+	device_state_t state;
+
+	if (sensor < 0 || sensor >= PMS7003_SENSOR_MAX) {
+		ERR("invalid sensor [%d]", sensor);
+		return false;
+	}
+
+	if (req_msg->has_property_key(req_msg, PROP_PRESENT))
+		resp_rep->set_bool_value(resp_rep, PROP_PRESENT, present);
+	if (!present)
+		return true;
+
+	device_state_get(&state);
+	_set_dust_properties(req_msg, resp_rep, &state.sensors[sensor].standard_particle, state.sensors[sensor].arrival_ms);
+	return true;
+}
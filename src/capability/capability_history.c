@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "st_things.h"
+#include "log.h"
+#include "history.h"
+#include "pm_store.h"
+
+static const char *QUERY_START = "start";
+static const char *QUERY_END = "end";
+static const char *QUERY_RESOLUTION = "resolution";
+
+static const char *PROP_START = "start";
+static const char *PROP_END = "end";
+static const char *PROP_RESOLUTION = "resolution";
+static const char *PROP_TIME = "time";
+static const char *PROP_COUNT = "count";
+static const char *PROP_FINEDUSTLEVEL = "fineDustLevel";
+static const char *PROP_FINEDUSTMIN = "fineDustMin";
+static const char *PROP_FINEDUSTMAX = "fineDustMax";
+static const char *PROP_DUSTLEVEL = "dustLevel";
+static const char *PROP_DUSTMIN = "dustMin";
+static const char *PROP_DUSTMAX = "dustMax";
+
+#define DEFAULT_RANGE_SECONDS		3600
+#define DEFAULT_RESOLUTION_SECONDS	60
+#define MAX_POINTS					1440	// resolution is raised to keep the response within MAX_POINTS buckets
+#define SOURCE_CHUNK				1024	// source buckets fetched per step
+
+#define PM2_5	1	// history channel index
+#define PM10	2
+
+/*
+ * History of the dust sensor : GET /history/dustSensor/main/0?start=<utc>&end=<utc>&resolution=<seconds>
+ *   start, end : UTC seconds, default the last hour
+ *   resolution : bucket width in seconds, default 60, raised to keep at most MAX_POINTS buckets,
+ *                rounded up to whole minutes from a minute, to whole hours from an hour
+ * Response (one entry per non-empty bucket, int arrays) :
+ *   time : bucket start
+ *   fineDustLevel / fineDustMin / fineDustMax : mean / min / max of PM2.5
+ *   dustLevel / dustMin / dustMax : mean / min / max of PM10
+ *   count : number of sensor readings in the bucket, the mean is taken over them
+ *           a minute from the PM store keeps its mean only and counts as one reading
+ * Sources : per-second and per-minute history in memory, minutes older than a day from the PM store,
+ * hourly history in memory for resolutions of an hour and more.
+ */
+
+typedef enum {
+	COLUMN_MEAN = 0,
+	COLUMN_MIN,
+	COLUMN_MAX,
+} _column_e;
+
+typedef struct {
+	uint16_t	min;
+	uint16_t	max;
+	uint64_t	sum;	// mean = sum / count
+} _bucket_stat_t;
+
+typedef struct {
+	uint32_t		time;
+	uint32_t		count;
+	_bucket_stat_t	pm[HISTORY_PM_CHANNELS];
+} _bucket_t;
+
+static uint32_t _get_query_uint(st_things_get_request_message_s *req_msg, const char *key, uint32_t default_value)
+{
+	char *value = NULL;
+	uint32_t ret = default_value;
+
+	if (req_msg->get_query_value(req_msg, key, &value) && value) {
+		ret = strtoul(value, NULL, 10);
+		free(value);
+	}
+
+	return ret;
+}
+
+/*
+ * fold one source bucket into the output bucket, weighted by its number of readings
+ */
+static void _fold(_bucket_t *buckets, uint32_t start, uint32_t resolution, size_t points, const history_aggregate_t *src)
+{
+	size_t idx;
+	int c;
+
+	if (src->time < start || src->count == 0)
+		return;
+
+	idx = (src->time - start) / resolution;
+	if (idx >= points)
+		return;
+
+	for (c = 0; c < HISTORY_PM_CHANNELS; c++) {
+		_bucket_stat_t *stat = &buckets[idx].pm[c];
+
+		if (buckets[idx].count == 0 || src->pm[c].min < stat->min)
+			stat->min = src->pm[c].min;
+		if (buckets[idx].count == 0 || src->pm[c].max > stat->max)
+			stat->max = src->pm[c].max;
+		stat->sum += src->pm[c].sum;
+	}
+	buckets[idx].time = start + idx * resolution;
+	buckets[idx].count += src->count;
+}
+
+/*
+ * fold the stored minutes in [start, end] into the output buckets
+ */
+static void _fold_store(_bucket_t *buckets, uint32_t start, uint32_t resolution, size_t points,
+		uint32_t from, uint32_t to, pm_store_record_t *records)
+{
+	while (from <= to) {
+		size_t n = pm_store_query(from, to, records, SOURCE_CHUNK);
+		size_t i;
+
+		for (i = 0; i < n; i++) {
+			history_aggregate_t agg;
+			memset(&agg, 0, sizeof(agg));
+			agg.time = records[i].time;
+			agg.count = 1;
+			agg.pm[0].min = agg.pm[0].max = agg.pm[0].sum = records[i].pm1_0;
+			agg.pm[PM2_5].min = agg.pm[PM2_5].max = agg.pm[PM2_5].sum = records[i].pm2_5;
+			agg.pm[PM10].min = agg.pm[PM10].max = agg.pm[PM10].sum = records[i].pm10;
+			_fold(buckets, start, resolution, points, &agg);
+		}
+
+		if (n < SOURCE_CHUNK || records[n - 1].time == UINT32_MAX)
+			break;
+		from = records[n - 1].time + 1;
+	}
+}
+
+/*
+ * fold the in-memory buckets of res in [from, to] into the output buckets
+ */
+static void _fold_memory(_bucket_t *buckets, uint32_t start, uint32_t resolution, size_t points,
+		history_resolution_e res, uint32_t from, uint32_t to, history_aggregate_t *source)
+{
+	while (from <= to) {
+		size_t n = history_query(res, from, to, source, SOURCE_CHUNK);
+		size_t i;
+
+		for (i = 0; i < n; i++)
+			_fold(buckets, start, resolution, points, &source[i]);
+
+		if (n < SOURCE_CHUNK || source[n - 1].time == UINT32_MAX)
+			break;
+		from = source[n - 1].time + 1;
+	}
+}
+
+static void _set_column(st_things_representation_s *resp_rep, const char *key, int64_t *column,
+		const _bucket_t *buckets, const size_t *used, size_t n, int channel, _column_e what)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		const _bucket_t *b = &buckets[used[i]];
+		switch (what) {
+		case COLUMN_MEAN:
+			column[i] = b->pm[channel].sum / b->count;
+			break;
+		case COLUMN_MIN:
+			column[i] = b->pm[channel].min;
+			break;
+		case COLUMN_MAX:
+		default:
+			column[i] = b->pm[channel].max;
+			break;
+		}
+	}
+	resp_rep->set_int_array_value(resp_rep, key, column, n);
+}
+
+bool handle_get_request_on_resource_history_dustsensor(st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep)
+{
+	uint32_t now = time(NULL);
+	uint32_t end = _get_query_uint(req_msg, QUERY_END, now);
+	uint32_t start = _get_query_uint(req_msg, QUERY_START, (end > DEFAULT_RANGE_SECONDS) ? end - DEFAULT_RANGE_SECONDS : 0);
+	uint32_t resolution = _get_query_uint(req_msg, QUERY_RESOLUTION, DEFAULT_RESOLUTION_SECONDS);
+	history_resolution_e res = HISTORY_RES_SECOND;
+	uint32_t width = 1;
+	uint64_t rounded = 0;
+	history_aggregate_t oldest;
+	_bucket_t *buckets = NULL;
+	void *source = NULL;
+	size_t *used = NULL;
+	int64_t *column = NULL;
+	size_t points = 0;
+	size_t n = 0;
+	size_t i;
+	bool ret = false;
+
+	if (start > end) {
+		ERR("invalid range [%u, %u]", start, end);
+		return false;
+	}
+	if (resolution == 0)
+		resolution = 1;
+
+	// keep the response bounded : raise the resolution before the source tier is chosen
+	if ((uint64_t)(end - start) / resolution + 1 > MAX_POINTS)
+		resolution = (end - start) / (MAX_POINTS - 1) + 1;
+
+	// a resolution of a minute or an hour and more is a whole number of minute or hour buckets
+	if (resolution >= history_resolution_seconds(HISTORY_RES_HOUR))
+		width = history_resolution_seconds(HISTORY_RES_HOUR);
+	else if (resolution >= history_resolution_seconds(HISTORY_RES_MINUTE))
+		width = history_resolution_seconds(HISTORY_RES_MINUTE);
+	rounded = ((uint64_t)resolution + width - 1) / width * width;
+	resolution = (rounded > UINT32_MAX) ? rounded - width : rounded;
+
+	// coarsest source tier whose bucket width divides the resolution
+	if (resolution % history_resolution_seconds(HISTORY_RES_HOUR) == 0)
+		res = HISTORY_RES_HOUR;
+	else if (resolution % history_resolution_seconds(HISTORY_RES_MINUTE) == 0)
+		res = HISTORY_RES_MINUTE;
+
+	// aligning start can add one bucket, drop the oldest ones beyond MAX_POINTS
+	start -= start % resolution;
+	points = (end - start) / resolution + 1;
+	if (points > MAX_POINTS) {
+		start += (points - MAX_POINTS) * resolution;
+		points = MAX_POINTS;
+	}
+
+	buckets = calloc(points, sizeof(_bucket_t));
+	source = malloc(SOURCE_CHUNK * (sizeof(history_aggregate_t) > sizeof(pm_store_record_t) ?
+			sizeof(history_aggregate_t) : sizeof(pm_store_record_t)));
+	used = malloc(points * sizeof(size_t));
+	column = malloc(points * sizeof(int64_t));
+	if (!buckets || !source || !used || !column) {
+		ERR("out of memory");
+		goto out;
+	}
+
+	// minutes older than the in-memory minute ring come from the PM store
+	if (res == HISTORY_RES_MINUTE) {
+		uint32_t memory_from = history_query(res, 0, UINT32_MAX, &oldest, 1) ? oldest.time : now;
+		if (start < memory_from)
+			_fold_store(buckets, start, resolution, points, start, (end < memory_from) ? end : memory_from - 1, source);
+		if (end >= memory_from)
+			_fold_memory(buckets, start, resolution, points, res, (start > memory_from) ? start : memory_from, end, source);
+	} else {
+		_fold_memory(buckets, start, resolution, points, res, start, end, source);
+	}
+
+	for (i = 0; i < points; i++) {
+		if (buckets[i].count > 0)
+			used[n++] = i;
+	}
+
+	resp_rep->set_int_value(resp_rep, PROP_START, start);
+	resp_rep->set_int_value(resp_rep, PROP_END, end);
+	resp_rep->set_int_value(resp_rep, PROP_RESOLUTION, resolution);
+
+	for (i = 0; i < n; i++)
+		column[i] = buckets[used[i]].time;
+	resp_rep->set_int_array_value(resp_rep, PROP_TIME, column, n);
+	for (i = 0; i < n; i++)
+		column[i] = buckets[used[i]].count;
+	resp_rep->set_int_array_value(resp_rep, PROP_COUNT, column, n);
+
+	_set_column(resp_rep, PROP_FINEDUSTLEVEL, column, buckets, used, n, PM2_5, COLUMN_MEAN);
+	_set_column(resp_rep, PROP_FINEDUSTMIN, column, buckets, used, n, PM2_5, COLUMN_MIN);
+	_set_column(resp_rep, PROP_FINEDUSTMAX, column, buckets, used, n, PM2_5, COLUMN_MAX);
+	_set_column(resp_rep, PROP_DUSTLEVEL, column, buckets, used, n, PM10, COLUMN_MEAN);
+	_set_column(resp_rep, PROP_DUSTMIN, column, buckets, used, n, PM10, COLUMN_MIN);
+	_set_column(resp_rep, PROP_DUSTMAX, column, buckets, used, n, PM10, COLUMN_MAX);
+
+	DBG("history [%u, %u] resolution [%u] : %zu buckets", start, end, resolution, n);
+	ret = true;
+
+out:
+	free(buckets);
+	free(source);
+	free(used);
+	free(column);
+	return ret;
+}
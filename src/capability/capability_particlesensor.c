@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "st_things.h"
+#include "log.h"
+#include "device_state.h"
+
+static const char *PROP_STANDARDPARTICLE = "standardParticle";
+static const char *PROP_ATMOSPHERICENV = "atmosphericEnv";
+static const char *PROP_PARTICLECOUNT = "particleCount";
+static const char *PROP_FINEDUSTSTATS = "fineDustStats";
+static const char *PROP_DUSTSTATS = "dustStats";
+
+/*
+ * Particle Sensor attributes : complete PMS7003 measurement in one representation
+ *   standardParticle: [PM1.0, PM2.5, PM10], CF=1 standard particle, micrograms per cubic meter
+ *   atmosphericEnv: [PM1.0, PM2.5, PM10], under atmospheric environment, micrograms per cubic meter
+ *   particleCount: [>0.3um, >0.5um, >1.0um, >2.5um, >5.0um, >10um], number of particles in 0.1 L of air
+ *   fineDustStats: [EWMA, 10 s mean, 1 min mean, 15 min mean, median], PM2.5 rolling statistics
+ *   dustStats: [EWMA, 10 s mean, 1 min mean, 15 min mean, median], PM10 rolling statistics
+ */
+
+static void _set_stats(st_things_representation_s *resp_rep, const char *key, const rolling_stats_result_t *stats)
+{
+	int64_t value[5] = {
+		stats->ewma,
+		stats->mean[ROLLING_WINDOW_10S],
+		stats->mean[ROLLING_WINDOW_1MIN],
+		stats->mean[ROLLING_WINDOW_15MIN],
+		stats->median,
+	};
+
+	resp_rep->set_int_array_value(resp_rep, key, value, 5);
+}
+
+bool handle_get_request_on_resource_capability_particlesensor(st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep)
+{
+	device_state_t state;
+
+	// one snapshot for every property of the response, the statistics include the reading
+	device_state_get(&state);
+
+	if (req_msg->has_property_key(req_msg, PROP_STANDARDPARTICLE)) {
+		const _concentration_unit_t *standard = &state.standard_particle;
+		int64_t value[3] = { standard->PM1_0, standard->PM2_5, standard->PM10 };
+		resp_rep->set_int_array_value(resp_rep, PROP_STANDARDPARTICLE, value, 3);
+	}
+	if (req_msg->has_property_key(req_msg, PROP_ATMOSPHERICENV)) {
+		const _concentration_unit_t *atmospheric = &state.atmospheric_env;
+		int64_t value[3] = { atmospheric->PM1_0, atmospheric->PM2_5, atmospheric->PM10 };
+		resp_rep->set_int_array_value(resp_rep, PROP_ATMOSPHERICENV, value, 3);
+	}
+	if (req_msg->has_property_key(req_msg, PROP_PARTICLECOUNT)) {
+		const _particle_count_t *count = &state.particle_count;
+		int64_t value[6] = { count->PC0_3, count->PC0_5, count->PC1_0, count->PC2_5, count->PC5_0, count->PC10 };
+		resp_rep->set_int_array_value(resp_rep, PROP_PARTICLECOUNT, value, 6);
+	}
+	if (req_msg->has_property_key(req_msg, PROP_FINEDUSTSTATS))
+		_set_stats(resp_rep, PROP_FINEDUSTSTATS, &state.fine_dust_stats);
+	if (req_msg->has_property_key(req_msg, PROP_DUSTSTATS))
+		_set_stats(resp_rep, PROP_DUSTSTATS, &state.dust_stats);
+	return true;
+}
@@ -19,19 +19,18 @@
 
 static const char *PROP_POWER = "power";
 
-#define VALUE_STR_LEN_MAX 32
 static const char *VALUE_SWITCH_ON = "on";
 static const char *VALUE_SWITCH_OFF = "off";
-static char g_switch[VALUE_STR_LEN_MAX] = "off";
 
 extern void set_switch_status(bool status);
+extern bool get_switch_status(void);
 
 bool handle_get_request_on_resource_capability_switch(st_things_get_request_message_s* req_msg, st_things_representation_s* resp_rep)
 {
 	DBG("Received a GET request on %s\n", req_msg->resource_uri);
 
 	if (req_msg->has_property_key(req_msg, PROP_POWER)) {
-		resp_rep->set_str_value(resp_rep, PROP_POWER, g_switch);
+		resp_rep->set_str_value(resp_rep, PROP_POWER, get_switch_status() ? VALUE_SWITCH_ON : VALUE_SWITCH_OFF);
 	}
 
 	return true;
@@ -42,6 +41,7 @@ bool handle_set_request_on_resource_capability_switch(st_things_set_request_mess
 	DBG("Received a SET request on %s\n", req_msg->resource_uri);
 
 	char *str_value = NULL;
+	bool switch_status = false;
 	req_msg->rep->get_str_value(req_msg->rep, PROP_POWER, &str_value);
 
 	/* check validation */
@@ -52,15 +52,11 @@ bool handle_set_request_on_resource_capability_switch(st_things_set_request_mess
 		return false;
 	}
 
-	if (0 != strncmp(str_value, g_switch, strlen(g_switch))) {
-		strncpy(g_switch, str_value, VALUE_STR_LEN_MAX);
-		if (0 == strncmp(g_switch, VALUE_SWITCH_ON, strlen(VALUE_SWITCH_ON))) {
-			set_switch_status(true);
-		} else {
-			set_switch_status(false);
-		}
+	switch_status = (0 == strncmp(str_value, VALUE_SWITCH_ON, strlen(VALUE_SWITCH_ON)));
+	if (switch_status != get_switch_status()) {
+		set_switch_status(switch_status);
 	}
-	resp_rep->set_str_value(resp_rep, PROP_POWER, g_switch);
+	resp_rep->set_str_value(resp_rep, PROP_POWER, switch_status ? VALUE_SWITCH_ON : VALUE_SWITCH_OFF);
 
 	st_things_notify_observers(req_msg->resource_uri);
 
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+
+static const config_spec_option_t *_find_option(const config_spec_option_t *options, size_t n_options, const char *key)
+{
+	size_t i;
+
+	for (i = 0; i < n_options; i++) {
+		if (0 == strcmp(options[i].key, key))
+			return &options[i];
+	}
+	return NULL;
+}
+
+bool config_spec_parse(const char *spec, const char *name,
+		const config_spec_option_t *options, size_t n_options, void *config)
+{
+	char *str = NULL;
+	char *token = NULL;
+	char *save = NULL;
+	bool ret = true;
+
+	if (!spec || spec[0] == '\0')
+		return true;
+
+	str = strdup(spec);
+	if (!str)
+		return false;
+
+	for (token = strtok_r(str, ",", &save); token && ret; token = strtok_r(NULL, ",", &save)) {
+		const config_spec_option_t *option = NULL;
+		char *value = strchr(token, '=');
+
+		if (!value) {
+			ERR("%s option [%s] has no value", name, token);
+			ret = false;
+			break;
+		}
+		*value++ = '\0';
+
+		option = _find_option(options, n_options, token);
+		ret = option && option->handler((char *)config + option->offset, value);
+		if (!ret)
+			ERR("invalid %s option [%s=%s]", name, token, value);
+	}
+
+	free(str);
+	return ret;
+}
+
+bool config_spec_uint(void *field, const char *value)
+{
+	char *end = NULL;
+	unsigned long v = strtoul(value, &end, 10);
+
+	if (end == value || *end != '\0')
+		return false;
+
+	*(unsigned int *)field = v;
+	return true;
+}
+
+bool config_spec_double(void *field, const char *value)
+{
+	char *end = NULL;
+	double v = strtod(value, &end);
+
+	if (end == value || *end != '\0')
+		return false;
+
+	*(double *)field = v;
+	return true;
+}
+
+bool config_spec_off(void *field, const char *value)
+{
+	unsigned int off = 0;
+
+	if (!config_spec_uint(&off, value))
+		return false;
+
+	*(bool *)field = (off == 0);
+	return true;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "device_state.h"
+
+/*
+ * seqlock : seq is odd while an update is in progress
+ * a reader copies the state and retries if seq changed or was odd meanwhile
+ */
+static device_state_t g_state;
+static unsigned int seq = 0;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void _write_begin(void)
+{
+	pthread_mutex_lock(&writer_lock);
+	__atomic_store_n(&seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void _write_end(void)
+{
+	g_state.version++;
+	__atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&writer_lock);
+}
+
+void device_state_init(uint32_t fan_speed, bool switch_status)
+{
+	_write_begin();
+	memset(&g_state, 0, sizeof(device_state_t));
+	g_state.fan_speed = fan_speed;
+	g_state.switch_status = switch_status;
+	_write_end();
+}
+
+void device_state_get(device_state_t *snapshot)
+{
+	unsigned int begin, end;
+
+	do {
+		begin = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+		memcpy(snapshot, &g_state, sizeof(device_state_t));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		end = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+	} while ((begin & 1) || begin != end);
+}
+
+int64_t device_state_age_ms(uint64_t arrival_ms)
+{
+	struct timespec ts;
+	int64_t now;
+
+	if (arrival_ms == 0)
+		return -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	return (now > (int64_t)arrival_ms) ? now - (int64_t)arrival_ms : 0;
+}
+
+void device_state_set_sensor(const _pms7003_protocol_t *frame,
+		const rolling_stats_result_t *fine_dust, const rolling_stats_result_t *dust)
+{
+	_write_begin();
+	g_state.standard_particle = frame->standard_particle;
+	g_state.atmospheric_env = frame->atmospheric_env;
+	g_state.particle_count = frame->particle_count;
+	g_state.arrival_ms = frame->arrival_ms;
+	g_state.fine_dust_stats = *fine_dust;
+	g_state.dust_stats = *dust;
+	_write_end();
+}
+
+void device_state_set_sensor_reading(int sensor, const _pms7003_protocol_t *frame)
+{
+	if (sensor < 0 || sensor >= PMS7003_SENSOR_MAX)
+		return;
+
+	_write_begin();
+	g_state.sensors[sensor].standard_particle = frame->standard_particle;
+	g_state.sensors[sensor].arrival_ms = frame->arrival_ms;
+	_write_end();
+}
+
+void device_state_set_fan_speed(uint32_t fan_speed)
+{
+	_write_begin();
+	g_state.fan_speed = fan_speed;
+	_write_end();
+}
+
+void device_state_set_switch(bool switch_status)
+{
+	_write_begin();
+	g_state.switch_status = switch_status;
+	_write_end();
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+#include "fan_controller.h"
+
+#define DEFAULT_DWELL	30
+
+void fan_controller_config_default(fan_controller_config_t *config)
+{
+	config->input = FAN_INPUT_RAW;
+	config->dwell = DEFAULT_DWELL;
+}
+
+static bool _parse_input(void *field, const char *value)
+{
+	static const char *names[] = {
+		[FAN_INPUT_RAW] = "raw",
+		[FAN_INPUT_EWMA] = "ewma",
+		[FAN_INPUT_MEDIAN] = "median",
+		[FAN_INPUT_MEAN_10S] = "mean10s",
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (0 == strcmp(value, names[i])) {
+			*(fan_input_e *)field = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static const config_spec_option_t fan_options[] = {
+	CONFIG_SPEC_OPTION("input", _parse_input, fan_controller_config_t, input),
+	CONFIG_SPEC_OPTION("dwell", config_spec_uint, fan_controller_config_t, dwell),
+};
+
+bool fan_controller_parse_config(const char *spec, fan_controller_config_t *config)
+{
+	fan_controller_config_default(config);
+	return config_spec_parse(spec, "fan", fan_options, sizeof(fan_options) / sizeof(fan_options[0]), config);
+}
+
+void fan_controller_init(fan_controller_t *ctl, const fan_controller_tier_t *tiers, int n_tiers,
+		const fan_controller_config_t *config)
+{
+	memset(ctl, 0, sizeof(fan_controller_t));
+	ctl->tiers = tiers;
+	ctl->n_tiers = n_tiers;
+	ctl->config = *config;
+}
+
+static int _tier_of(const fan_controller_t *ctl, uint32_t fan_speed)
+{
+	int i;
+
+	for (i = 0; i < ctl->n_tiers; i++) {
+		if (ctl->tiers[i].fan_speed == fan_speed)
+			return i;
+	}
+	return 0;
+}
+
+uint32_t fan_controller_update(fan_controller_t *ctl, uint32_t now_sec, uint32_t input, uint32_t fan_speed)
+{
+	int current, target;
+
+	if (!ctl->started || fan_speed != ctl->fan_speed) {
+		// first call or speed changed outside the controller, the next change is not held
+		ctl->started = true;
+		ctl->fan_speed = fan_speed;
+		ctl->changed_sec = now_sec - ctl->config.dwell;
+	}
+
+	current = target = _tier_of(ctl, fan_speed);
+	while (target + 1 < ctl->n_tiers && input > ctl->tiers[target + 1].up)
+		target++;
+	while (target > 0 && input <= ctl->tiers[target].down)
+		target--;
+
+	if (target == current)
+		return fan_speed;
+
+	if (now_sec - ctl->changed_sec < ctl->config.dwell) {
+		ctl->stats.held++;
+		return fan_speed;
+	}
+
+	ctl->stats.changes++;
+	ctl->changed_sec = now_sec;
+	ctl->fan_speed = ctl->tiers[target].fan_speed;
+	return ctl->fan_speed;
+}
+
+void fan_controller_get_stats(const fan_controller_t *ctl, fan_controller_stats_t *stats)
+{
+	*stats = ctl->stats;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+#include "fan_pid.h"
+
+#define DEFAULT_SETPOINT	12
+#define DEFAULT_KP_MILLI	20000	// 20 permille per ug/m3
+#define DEFAULT_KI_MILLI	500		// 0.5 permille per ug/m3 s
+#define DEFAULT_KD_MILLI	0
+
+#define OUTPUT_MAX			((int64_t)FAN_PID_DUTY_MAX * 1000)
+
+void fan_pid_config_default(fan_pid_config_t *config)
+{
+	config->setpoint = DEFAULT_SETPOINT;
+	config->kp_milli = DEFAULT_KP_MILLI;
+	config->ki_milli = DEFAULT_KI_MILLI;
+	config->kd_milli = DEFAULT_KD_MILLI;
+}
+
+// gain in thousandths
+static bool _parse_milli(void *field, const char *value)
+{
+	double v = 0;
+
+	if (!config_spec_double(&v, value))
+		return false;
+
+	v *= 1000;
+	*(int32_t *)field = (int32_t)(v < 0 ? v - 0.5 : v + 0.5);
+	return true;
+}
+
+static const config_spec_option_t pid_options[] = {
+	CONFIG_SPEC_OPTION("setpoint", config_spec_uint, fan_pid_config_t, setpoint),
+	CONFIG_SPEC_OPTION("kp", _parse_milli, fan_pid_config_t, kp_milli),
+	CONFIG_SPEC_OPTION("ki", _parse_milli, fan_pid_config_t, ki_milli),
+	CONFIG_SPEC_OPTION("kd", _parse_milli, fan_pid_config_t, kd_milli),
+};
+
+bool fan_pid_parse_config(const char *spec, fan_pid_config_t *config)
+{
+	fan_pid_config_default(config);
+	return config_spec_parse(spec, "pid", pid_options, sizeof(pid_options) / sizeof(pid_options[0]), config);
+}
+
+void fan_pid_init(fan_pid_t *pid, const fan_pid_config_t *config)
+{
+	memset(pid, 0, sizeof(fan_pid_t));
+	pid->config = *config;
+}
+
+void fan_pid_reset(fan_pid_t *pid)
+{
+	pid->started = false;
+	pid->integral = 0;
+}
+
+uint32_t fan_pid_update(fan_pid_t *pid, uint64_t now_ms, uint32_t input)
+{
+	int64_t error = (int64_t)input - pid->config.setpoint;
+	int64_t dt_ms, p, d = 0, integral, out;
+
+	if (!pid->started) {
+		pid->started = true;
+		pid->last_ms = now_ms;
+		pid->last_input = input;
+	}
+	dt_ms = (int64_t)(now_ms - pid->last_ms);
+
+	p = pid->config.kp_milli * error;
+	if (dt_ms > 0)
+		d = -(int64_t)pid->config.kd_milli * ((int64_t)input - pid->last_input) * 1000 / dt_ms;
+
+	integral = pid->integral + pid->config.ki_milli * error * dt_ms / 1000;
+	if (integral < 0)
+		integral = 0;
+	if (integral > OUTPUT_MAX)
+		integral = OUTPUT_MAX;
+
+	// conditional integration : keep the integral while saturated in the error direction
+	out = p + integral + d;
+	if ((out > OUTPUT_MAX && error > 0) || (out < 0 && error < 0))
+		integral = pid->integral;
+	pid->integral = integral;
+
+	out = p + integral + d;
+	if (out < 0)
+		out = 0;
+	if (out > OUTPUT_MAX)
+		out = OUTPUT_MAX;
+
+	pid->last_ms = now_ms;
+	pid->last_input = input;
+	pid->duty = (uint32_t)(out / 1000);
+	return pid->duty;
+}
+
+int fan_pid_level(uint32_t duty, int current, int levels)
+{
+	// position in quarter steps, boundaries at +-3/4 step from the current level
+	int64_t x = (int64_t)duty * (levels - 1) * 4;
+
+	if (levels < 2)
+		return 0;
+	if (current < 0)
+		current = 0;
+	if (current > levels - 1)
+		current = levels - 1;
+
+	while (current < levels - 1 && x >= (int64_t)(4 * current + 3) * FAN_PID_DUTY_MAX)
+		current++;
+	while (current > 0 && x <= (int64_t)(4 * current - 3) * FAN_PID_DUTY_MAX)
+		current--;
+	return current;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include "history.h"
+
+typedef struct {
+	history_aggregate_t	*ring;
+	unsigned int		depth;
+	unsigned int		head;	// next slot to write
+	unsigned int		count;	// valid slots
+	uint32_t			width;	// bucket width in seconds
+	history_aggregate_t	open;	// bucket being accumulated
+} _aggregate_tier_t;
+
+static history_sample_t second_ring[HISTORY_SECOND_DEPTH];
+static unsigned int second_head = 0;
+static unsigned int second_count = 0;
+
+static history_aggregate_t minute_ring[HISTORY_MINUTE_DEPTH];
+static history_aggregate_t hour_ring[HISTORY_HOUR_DEPTH];
+
+static _aggregate_tier_t minute_tier = { .ring = minute_ring, .depth = HISTORY_MINUTE_DEPTH, .width = 60 };
+static _aggregate_tier_t hour_tier = { .ring = hour_ring, .depth = HISTORY_HOUR_DEPTH, .width = 3600 };
+
+// readers run on the request thread, the writer on the main loop
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static history_bucket_cb g_bucket_cb = NULL;
+
+uint32_t history_resolution_seconds(history_resolution_e res)
+{
+	switch (res) {
+	case HISTORY_RES_MINUTE:
+		return 60;
+	case HISTORY_RES_HOUR:
+		return 3600;
+	case HISTORY_RES_SECOND:
+	default:
+		return 1;
+	}
+}
+
+void history_init(void)
+{
+	pthread_mutex_lock(&history_lock);
+	second_head = second_count = 0;
+	minute_tier.head = minute_tier.count = 0;
+	minute_tier.open.count = 0;
+	hour_tier.head = hour_tier.count = 0;
+	hour_tier.open.count = 0;
+	pthread_mutex_unlock(&history_lock);
+}
+
+static void _stat_add(history_stat_t *stat, uint16_t val, bool first)
+{
+	if (first) {
+		stat->min = stat->max = val;
+		stat->sum = val;
+		return;
+	}
+	if (val < stat->min)
+		stat->min = val;
+	if (val > stat->max)
+		stat->max = val;
+	stat->sum += val;
+}
+
+void history_set_bucket_cb(history_bucket_cb bucket_cb)
+{
+	pthread_mutex_lock(&history_lock);
+	g_bucket_cb = bucket_cb;
+	pthread_mutex_unlock(&history_lock);
+}
+
+/*
+ * returns true if the open bucket was closed into *closed
+ */
+static bool _tier_add(_aggregate_tier_t *tier, uint32_t time, const uint16_t *pm, history_aggregate_t *closed)
+{
+	uint32_t bucket = time - (time % tier->width);
+	bool ret = false;
+	int i;
+
+	// a new bucket starts (or the clock moved back) : push the open one into the ring
+	if (tier->open.count > 0 && tier->open.time != bucket) {
+		*closed = tier->open;
+		ret = true;
+		tier->ring[tier->head] = tier->open;
+		tier->head = (tier->head + 1) % tier->depth;
+		if (tier->count < tier->depth)
+			tier->count++;
+		tier->open.count = 0;
+	}
+
+	if (tier->open.count == 0)
+		tier->open.time = bucket;
+
+	for (i = 0; i < HISTORY_PM_CHANNELS; i++)
+		_stat_add(&tier->open.pm[i], pm[i], tier->open.count == 0);
+
+	if (tier->open.count < UINT16_MAX)
+		tier->open.count++;
+
+	return ret;
+}
+
+void history_add(uint32_t time, const _concentration_unit_t *pm)
+{
+	uint16_t val[HISTORY_PM_CHANNELS] = { pm->PM1_0, pm->PM2_5, pm->PM10 };
+	unsigned int last = (second_head + HISTORY_SECOND_DEPTH - 1) % HISTORY_SECOND_DEPTH;
+	history_aggregate_t minute, hour;
+	bool minute_closed, hour_closed;
+	history_bucket_cb bucket_cb;
+
+	pthread_mutex_lock(&history_lock);
+
+	// second tier keeps the latest reading of each second
+	if (second_count == 0 || second_ring[last].time != time) {
+		last = second_head;
+		second_head = (second_head + 1) % HISTORY_SECOND_DEPTH;
+		if (second_count < HISTORY_SECOND_DEPTH)
+			second_count++;
+	}
+	second_ring[last].time = time;
+	memcpy(second_ring[last].pm, val, sizeof(val));
+
+	minute_closed = _tier_add(&minute_tier, time, val, &minute);
+	hour_closed = _tier_add(&hour_tier, time, val, &hour);
+	bucket_cb = g_bucket_cb;
+
+	pthread_mutex_unlock(&history_lock);
+
+	// closed buckets are reported outside the lock, readers are not held up by the callback
+	if (bucket_cb && minute_closed)
+		bucket_cb(HISTORY_RES_MINUTE, &minute);
+	if (bucket_cb && hour_closed)
+		bucket_cb(HISTORY_RES_HOUR, &hour);
+}
+
+static bool _in_range(uint32_t time, uint32_t width, uint32_t start, uint32_t end)
+{
+	// bucket [time, time + width) overlaps [start, end]
+	return time <= end && time + width > start;
+}
+
+static size_t _query_seconds(uint32_t start, uint32_t end, history_aggregate_t *out, size_t max)
+{
+	size_t n = 0;
+	unsigned int i;
+
+	for (i = 0; i < second_count && n < max; i++) {
+		const history_sample_t *sample = &second_ring[(second_head + HISTORY_SECOND_DEPTH - second_count + i) % HISTORY_SECOND_DEPTH];
+		int c;
+
+		if (!_in_range(sample->time, 1, start, end))
+			continue;
+
+		out[n].time = sample->time;
+		out[n].count = 1;
+		for (c = 0; c < HISTORY_PM_CHANNELS; c++) {
+			out[n].pm[c].min = out[n].pm[c].max = sample->pm[c];
+			out[n].pm[c].sum = sample->pm[c];
+		}
+		n++;
+	}
+
+	return n;
+}
+
+static size_t _query_tier(const _aggregate_tier_t *tier, uint32_t start, uint32_t end, history_aggregate_t *out, size_t max)
+{
+	size_t n = 0;
+	unsigned int i;
+
+	for (i = 0; i < tier->count && n < max; i++) {
+		const history_aggregate_t *agg = &tier->ring[(tier->head + tier->depth - tier->count + i) % tier->depth];
+		if (_in_range(agg->time, tier->width, start, end))
+			out[n++] = *agg;
+	}
+
+	if (tier->open.count > 0 && n < max && _in_range(tier->open.time, tier->width, start, end))
+		out[n++] = tier->open;
+
+	return n;
+}
+
+size_t history_query(history_resolution_e res, uint32_t start, uint32_t end, history_aggregate_t *out, size_t max)
+{
+	size_t n = 0;
+
+	pthread_mutex_lock(&history_lock);
+	switch (res) {
+	case HISTORY_RES_SECOND:
+		n = _query_seconds(start, end, out, max);
+		break;
+	case HISTORY_RES_MINUTE:
+		n = _query_tier(&minute_tier, start, end, out, max);
+		break;
+	case HISTORY_RES_HOUR:
+		n = _query_tier(&hour_tier, start, end, out, max);
+		break;
+	default:
+		break;
+	}
+	pthread_mutex_unlock(&history_lock);
+
+	return n;
+}
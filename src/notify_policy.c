@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+#include "notify_policy.h"
+
+#define DEFAULT_ABS_DEADBAND	2
+#define DEFAULT_REL_DEADBAND	10
+#define DEFAULT_MIN_INTERVAL	5
+#define DEFAULT_HEARTBEAT		60
+
+void notify_policy_config_default(notify_policy_config_t *config)
+{
+	config->enabled = true;
+	config->abs_deadband = DEFAULT_ABS_DEADBAND;
+	config->rel_deadband = DEFAULT_REL_DEADBAND;
+	config->min_interval = DEFAULT_MIN_INTERVAL;
+	config->heartbeat = DEFAULT_HEARTBEAT;
+}
+
+static const config_spec_option_t notify_options[] = {
+	CONFIG_SPEC_OPTION("abs", config_spec_uint, notify_policy_config_t, abs_deadband),
+	CONFIG_SPEC_OPTION("rel", config_spec_uint, notify_policy_config_t, rel_deadband),
+	CONFIG_SPEC_OPTION("min", config_spec_uint, notify_policy_config_t, min_interval),
+	CONFIG_SPEC_OPTION("heartbeat", config_spec_uint, notify_policy_config_t, heartbeat),
+	CONFIG_SPEC_OPTION("off", config_spec_off, notify_policy_config_t, enabled),
+};
+
+bool notify_policy_parse_config(const char *spec, notify_policy_config_t *config)
+{
+	notify_policy_config_default(config);
+	return config_spec_parse(spec, "notify", notify_options, sizeof(notify_options) / sizeof(notify_options[0]), config);
+}
+
+void notify_policy_init(notify_policy_t *policy, const notify_policy_config_t *config)
+{
+	memset(policy, 0, sizeof(notify_policy_t));
+	policy->config = *config;
+}
+
+void notify_policy_reset(notify_policy_t *policy)
+{
+	policy->has_sent = false;
+}
+
+static bool _out_of_deadband(const notify_policy_t *policy, const uint32_t *values, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		uint32_t sent = policy->last_value[i];
+		uint32_t band = sent * policy->config.rel_deadband / 100;
+		uint32_t diff = (values[i] > sent) ? values[i] - sent : sent - values[i];
+
+		if (band < policy->config.abs_deadband)
+			band = policy->config.abs_deadband;
+		if (diff > band)
+			return true;
+	}
+	return false;
+}
+
+bool notify_policy_check(notify_policy_t *policy, uint32_t now_sec, const uint32_t *values, int n)
+{
+	uint32_t elapsed = now_sec - policy->last_sec;
+	bool send = false;
+
+	if (n > NOTIFY_POLICY_VALUES)
+		n = NOTIFY_POLICY_VALUES;
+
+	if (!policy->config.enabled || !policy->has_sent) {
+		send = true;
+	} else if (policy->config.heartbeat && elapsed >= policy->config.heartbeat) {
+		send = true;
+		if (!_out_of_deadband(policy, values, n))
+			policy->stats.heartbeats++;
+	} else if (elapsed >= policy->config.min_interval) {
+		send = _out_of_deadband(policy, values, n);
+	}
+
+	if (!send) {
+		policy->stats.suppressed++;
+		return false;
+	}
+
+	policy->has_sent = true;
+	policy->last_sec = now_sec;
+	memcpy(policy->last_value, values, n * sizeof(uint32_t));
+	policy->stats.sent++;
+	return true;
+}
+
+void notify_policy_get_stats(const notify_policy_t *policy, notify_policy_stats_t *stats)
+{
+	*stats = policy->stats;
+}
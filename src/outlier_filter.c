@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+#include "outlier_filter.h"
+
+#define DEFAULT_WINDOW			7
+#define DEFAULT_THRESHOLD_X10	30
+#define DEFAULT_FLOOR			10
+
+void outlier_filter_config_default(outlier_filter_config_t *config)
+{
+	config->enabled = true;
+	config->window = DEFAULT_WINDOW;
+	config->threshold_x10 = DEFAULT_THRESHOLD_X10;
+	config->floor = DEFAULT_FLOOR;
+}
+
+static bool _parse_window(void *field, const char *value)
+{
+	unsigned int window = 0;
+
+	if (!config_spec_uint(&window, value) || window < 3 || window > ROLLING_MEDIAN_WINDOW)
+		return false;
+
+	*(unsigned int *)field = window;
+	return true;
+}
+
+static bool _parse_threshold(void *field, const char *value)
+{
+	double threshold = 0;
+
+	if (!config_spec_double(&threshold, value) || threshold < 0)
+		return false;
+
+	*(unsigned int *)field = (unsigned int)(threshold * 10 + 0.5);
+	return true;
+}
+
+static const config_spec_option_t filter_options[] = {
+	CONFIG_SPEC_OPTION("window", _parse_window, outlier_filter_config_t, window),
+	CONFIG_SPEC_OPTION("threshold", _parse_threshold, outlier_filter_config_t, threshold_x10),
+	CONFIG_SPEC_OPTION("floor", config_spec_uint, outlier_filter_config_t, floor),
+	CONFIG_SPEC_OPTION("off", config_spec_off, outlier_filter_config_t, enabled),
+};
+
+bool outlier_filter_parse_config(const char *spec, outlier_filter_config_t *config)
+{
+	outlier_filter_config_default(config);
+	return config_spec_parse(spec, "filter", filter_options, sizeof(filter_options) / sizeof(filter_options[0]), config);
+}
+
+void outlier_filter_init(outlier_filter_t *filter, const outlier_filter_config_t *config)
+{
+	int i;
+
+	memset(filter, 0, sizeof(outlier_filter_t));
+	filter->config = *config;
+	for (i = 0; i < OUTLIER_FILTER_CHANNELS; i++)
+		rolling_median_init(&filter->median[i], config->window);
+}
+
+static bool _is_outlier(const outlier_filter_t *filter, const rolling_median_t *median, uint16_t value)
+{
+	uint32_t limit;
+	uint16_t med;
+
+	if (median->count < median->size)
+		return false;
+
+	med = rolling_median_get(median);
+	// 1.4826 * MAD estimates the standard deviation of normally distributed data
+	limit = ((uint32_t)filter->config.threshold_x10 * rolling_median_mad(median) * 14826 + 50000) / 100000;
+	if (limit < filter->config.floor)
+		limit = filter->config.floor;
+
+	return (uint32_t)abs((int)value - (int)med) > limit;
+}
+
+bool outlier_filter_check(outlier_filter_t *filter, const _pms7003_protocol_t *frame)
+{
+	const uint16_t value[OUTLIER_FILTER_CHANNELS] = {
+		frame->standard_particle.PM1_0,
+		frame->standard_particle.PM2_5,
+		frame->standard_particle.PM10,
+	};
+	bool outlier = false;
+	int i;
+
+	if (!filter->config.enabled) {
+		filter->stats.accepted++;
+		return true;
+	}
+
+	for (i = 0; i < OUTLIER_FILTER_CHANNELS; i++) {
+		if (_is_outlier(filter, &filter->median[i], value[i])) {
+			filter->stats.rejected_channel[i]++;
+			outlier = true;
+		}
+		rolling_median_add(&filter->median[i], value[i]);
+	}
+
+	if (outlier)
+		filter->stats.rejected++;
+	else
+		filter->stats.accepted++;
+
+	return !outlier;
+}
+
+void outlier_filter_get_stats(const outlier_filter_t *filter, outlier_filter_stats_t *stats)
+{
+	*stats = filter->stats;
+}
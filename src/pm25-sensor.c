@@ -17,10 +17,26 @@
 #include <service_app.h>
 #include <app_common.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 #include <Ecore.h>
 #include "st_things.h"
 #include "log.h"
 #include "resource/resource_pms7003_sensor.h"
+#include "resource/resource_pms7003_reader.h"
+#include "device_state.h"
+#include "history.h"
+#include "rolling_stats.h"
+#include "outlier_filter.h"
+#include "notify_policy.h"
+#include "fan_controller.h"
+#include "fan_pid.h"
+#include "sampling_scheduler.h"
+#include "sensor_fusion.h"
+#include "pm_store.h"
+#ifdef PMS7003_BENCHMARK
+#include "resource/pms7003_bench.h"
+#endif
 
 #define _DEBUG_PRINT_
 #ifdef _DEBUG_PRINT_
@@ -30,10 +46,32 @@
 #define EVENT_INTERVAL_SECOND	(1.0f)	// sensor event timer : 1 second interval
 #define JSON_PATH "device_def.json"
 
+// outlier filter options "window=7,threshold=3.0,floor=10", "off=1" to disable
+#define OUTLIER_FILTER_ENV "PMS7003_FILTER"
+// observer notification options "abs=2,rel=10,min=5,heartbeat=60", "off=1" notifies every tick
+#define NOTIFY_POLICY_ENV "PMS7003_NOTIFY"
+#define NOTIFY_STATS_LOG_PERIOD	300	// timer ticks
+// auto fan options "input=ewma,dwell=30"
+#define FAN_CONTROLLER_ENV "PMS7003_FAN"
+// experimental, off unless set : "setpoint=12,kp=20,ki=0.5,kd=0" (or empty for defaults) runs auto fan on the PID loop
+// instead of the tier table, the gains are not tuned in closed loop yet
+#define FAN_PID_ENV "PMS7003_FAN_PID"
+// "passive" : one frame is requested per EVENT_INTERVAL_SECOND instead of the active mode stream
+// "adaptive" : passive, the interval follows the concentration dynamics (PMS7003_SAMPLING)
+#define SENSOR_MODE_ENV "PMS7003_MODE"
+// adaptive sampling options "min=1,max=60,abs=3,rel=15,sleep=30"
+#define SAMPLING_ENV "PMS7003_SAMPLING"
+// active mode : "latest" publishes only the newest received frame, "average" the mean of the skipped ones
+#define DRAIN_ENV "PMS7003_DRAIN"
+// several sensors : "method=median,stale=5000,band=5,exclude=15,errors=200", "off=1" publishes sensor 0 only
+#define FUSION_ENV "PMS7003_FUSION"
+#define READER_STATS_LOG_PERIOD	300	// timer ticks
+
 #define FINEDUST_LEVEL_PM2_5_GOOD       15
 #define FINEDUST_LEVEL_PM2_5_NORMAL     25
 #define FINEDUST_LEVEL_PM2_5_POOR       50
 //#define FINEDUST_LEVEL_PM2_5_VERYPOOR 51
+#define FINEDUST_LEVEL_HYSTERESIS       3	// ug/m3 below a level before the fan steps down
 
 #define MANUAL_FAN_SPEED_HIGH           0x04
 #define MANUAL_FAN_SPEED_MEDIUM         0x03
@@ -48,18 +86,62 @@
 static const char *RES_CAPABILITY_SWITCH_MAIN_0 = "/capability/switch/main/0";
 static const char *RES_CAPABILITY_FANSPEED_MAIN_0 = "/capability/fanSpeed/main/0";
 static const char *RES_CAPABILITY_DUSTSENSOR_MAIN_0 = "/capability/dustSensor/main/0";
+static const char *RES_CAPABILITY_PARTICLESENSOR_MAIN_0 = "/capability/particleSensor/main/0";
+static const char *RES_HISTORY_DUSTSENSOR_MAIN_0 = "/history/dustSensor/main/0";
+// readings of the additional sensors, sensor N on /capability/dustSensor/main/N
+static const char *RES_CAPABILITY_DUSTSENSOR_MAIN_N[PMS7003_SENSOR_MAX] = {
+	NULL,
+	"/capability/dustSensor/main/1",
+	"/capability/dustSensor/main/2",
+	"/capability/dustSensor/main/3",
+};
 
 Ecore_Timer *sensor_event_timer = NULL;
-pthread_mutex_t  mutex_lock = PTHREAD_MUTEX_INITIALIZER;
-static bool g_switch_status;
-static uint32_t g_fan_speed = FAN_SPEED_OFF;
 
-#define MUTEX_LOCK		pthread_mutex_lock(&mutex_lock)
-#define MUTEX_UNLOCK	pthread_mutex_unlock(&mutex_lock)
-#define UNUSED(x)		(void)(x)
+// rolling statistics of PM2.5 and PM10, updated on the main loop for every frame
+static rolling_stats_t fine_dust_stats;
+static rolling_stats_t dust_stats;
 
-_concentration_unit_t	standard_particle;	// CF=1，standard particle
-_concentration_unit_t	atmospheric_env;	// under atmospheric environment
+// spike rejection between the reader and set_sensor_value, main loop only
+static outlier_filter_t sensor_filter;
+
+// deadband and rate limit of the sensor observer notifications, timer callback only
+static notify_policy_t dustsensor_notify;
+static notify_policy_t particlesensor_notify;
+static notify_policy_t dustsensor_n_notify[PMS7003_SENSOR_MAX];
+static unsigned int notify_ticks = 0;
+
+/*
+ * fine dust sensor and fan speed data set (auto)
+ * PM2.5 rising     ~15     ~25     ~50     51~
+ * PM2.5 falling    ~12     ~22     ~47     48~
+ *                  GOOD    NORMAL  POOR    VERY POOR
+ * fan              OFF     LOW     MEDIUM  HIGH
+ */
+static const fan_controller_tier_t fan_tiers[] = {
+	{ FAN_SPEED_OFF,    0,                            0 },
+	{ FAN_SPEED_LOW,    FINEDUST_LEVEL_PM2_5_GOOD,    FINEDUST_LEVEL_PM2_5_GOOD - FINEDUST_LEVEL_HYSTERESIS },
+	{ FAN_SPEED_MEDIUM, FINEDUST_LEVEL_PM2_5_NORMAL,  FINEDUST_LEVEL_PM2_5_NORMAL - FINEDUST_LEVEL_HYSTERESIS },
+	{ FAN_SPEED_HIGH,   FINEDUST_LEVEL_PM2_5_POOR,    FINEDUST_LEVEL_PM2_5_POOR - FINEDUST_LEVEL_HYSTERESIS },
+};
+static fan_controller_t fan_controller;
+
+// optional closed loop auto mode, the duty is mapped onto the auto fan speeds
+static fan_pid_t fan_pid;
+static bool fan_pid_enabled = false;
+static bool fan_auto_running = false;	// auto mode on the previous sample, the PID restarts on entry
+#define FAN_SPEED_LEVELS	(FAN_SPEED_HIGH - FAN_SPEED_OFF + 1)
+
+// adaptive sampling interval, main loop only
+static sampling_scheduler_t sampling_scheduler;
+static bool sampling_adaptive = false;
+static unsigned int sampling_interval = 0;	// seconds
+
+// redundant sensors fused into the published values, main loop only
+static sensor_fusion_t sensor_fusion;
+static bool fusion_enabled = false;
+
+#define UNUSED(x)		(void)(x)
 
 /* get and set request handlers */
 extern bool handle_get_request_on_resource_capability_switch(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep);
@@ -67,40 +149,36 @@ extern bool handle_set_request_on_resource_capability_switch(st_things_set_reque
 extern bool handle_get_request_on_resource_capability_fanspeed(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep);
 extern bool handle_set_request_on_resource_capability_fanspeed(st_things_set_request_message_s *req_msg, st_things_representation_s *resp_rep);
 extern bool handle_get_request_on_resource_capability_dustsensor(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep);
+extern bool handle_get_request_on_resource_capability_dustsensor_n(int sensor, bool present, st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep);
+extern bool handle_get_request_on_resource_capability_particlesensor(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep);
+extern bool handle_get_request_on_resource_history_dustsensor(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep);
 
 /* resource pms7003 functions */
 extern bool resource_pms7003_init(void);
 extern void resource_pms7003_fini(void);
-extern bool resource_pms7003_read(void);
-
-static void _init_mutex(void)
-{
-	pthread_mutex_init(&mutex_lock, NULL);
-}
-
-static void _deinit_mutex(void)
-{
-	INFO("deinit_mutex...");
-	pthread_mutex_destroy(&mutex_lock);
-}
+extern int resource_pms7003_count(void);
+extern void resource_pms7003_get_frame_stats(int id, unsigned long *frames, unsigned long *checksum_errors);
 
+/*
+ * device state (PM values, fan speed, switch) is kept in device_state.c,
+ * getters below read a lock-free snapshot
+ */
 static bool _get_switch_status(void)
 {
-	bool status = false;
+	device_state_t state;
 
-	MUTEX_LOCK;
-	status = g_switch_status;
-	MUTEX_UNLOCK;
-
-	return status;
+	device_state_get(&state);
+	return state.switch_status;
 }
 
 void set_switch_status(bool status)
 {
-	MUTEX_LOCK;
-	g_switch_status = status;
-	MUTEX_UNLOCK;
+	device_state_set_switch(status);
+}
 
+bool get_switch_status(void)
+{
+	return _get_switch_status();
 }
 
 /*
@@ -108,9 +186,7 @@ void set_switch_status(bool status)
  */
 void set_fan_speed(uint32_t fan_speed)
 {
-	MUTEX_LOCK;
-	g_fan_speed = fan_speed;
-	MUTEX_UNLOCK;
+	device_state_set_fan_speed(fan_speed);
 
 	INFO("set fan speed : 0x%x", fan_speed);
 	st_things_notify_observers(RES_CAPABILITY_FANSPEED_MAIN_0);
@@ -118,9 +194,87 @@ void set_fan_speed(uint32_t fan_speed)
 
 void get_fan_speed(uint32_t *fan_speed)
 {
-	MUTEX_LOCK;
-	*fan_speed  = g_fan_speed;
-	MUTEX_UNLOCK;
+	device_state_t state;
+
+	device_state_get(&state);
+	*fan_speed = state.fan_speed;
+}
+
+static uint64_t _monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t _monotonic_seconds(void)
+{
+	return (uint32_t)(_monotonic_ms() / 1000);
+}
+
+static void _update_stats(uint32_t now, uint32_t pm2_5, uint32_t pm10, rolling_stats_result_t *fine, rolling_stats_result_t *dust)
+{
+	rolling_stats_add(&fine_dust_stats, now, pm2_5);
+	rolling_stats_add(&dust_stats, now, pm10);
+
+	rolling_stats_get(&fine_dust_stats, fine);
+	rolling_stats_get(&dust_stats, dust);
+}
+
+// PM2.5 reading the auto fan acts on
+static uint32_t _fan_input(uint32_t pm2_5, const rolling_stats_result_t *fine)
+{
+	switch (fan_controller.config.input) {
+	case FAN_INPUT_EWMA:
+		return fine->ewma;
+	case FAN_INPUT_MEDIAN:
+		return fine->median;
+	case FAN_INPUT_MEAN_10S:
+		return fine->mean[ROLLING_WINDOW_10S];
+	case FAN_INPUT_RAW:
+	default:
+		return pm2_5;
+	}
+}
+
+static void _init_fan_controller(void)
+{
+	fan_controller_config_t config;
+
+	if (!fan_controller_parse_config(getenv(FAN_CONTROLLER_ENV), &config)) {
+		ERR("invalid %s, using defaults", FAN_CONTROLLER_ENV);
+		fan_controller_config_default(&config);
+	}
+	fan_controller_init(&fan_controller, fan_tiers, sizeof(fan_tiers) / sizeof(fan_tiers[0]), &config);
+
+	const char *pid_spec = getenv(FAN_PID_ENV);
+	fan_pid_config_t pid_config;
+
+	if (!pid_spec)
+		return;
+	if (!fan_pid_parse_config(pid_spec, &pid_config)) {
+		ERR("invalid %s, PID auto mode disabled", FAN_PID_ENV);
+		return;
+	}
+	fan_pid_init(&fan_pid, &pid_config);
+	fan_pid_enabled = true;
+	WARN("experimental PID auto mode, PM2.5 setpoint %u ug/m3", pid_config.setpoint);
+}
+
+// next auto fan speed, from the PID duty or the tier table
+static uint32_t _auto_fan_speed(uint64_t now_ms, uint32_t input, uint32_t fan_speed)
+{
+	uint32_t duty;
+	int level;
+
+	if (!fan_pid_enabled)
+		return fan_controller_update(&fan_controller, now_ms / 1000, input, fan_speed);
+
+	duty = fan_pid_update(&fan_pid, now_ms, input);
+	level = fan_pid_level(duty, fan_speed - FAN_SPEED_OFF, FAN_SPEED_LEVELS);
+	DBG("fan duty %u permille, level %d", duty, level);
+	return FAN_SPEED_OFF + level;
 }
 
 /*
@@ -136,12 +290,16 @@ void set_sensor_value(_pms7003_protocol_t pms7003_protocol)
 {
 	uint32_t pm1_0, pm2_5, pm10;
 	uint32_t fan_speed;
+	uint64_t now_ms = _monotonic_ms();
+	uint32_t now = now_ms / 1000;
+	rolling_stats_result_t fine, dust;
 
-	MUTEX_LOCK;
-	pm1_0 = standard_particle.PM1_0 = pms7003_protocol.standard_particle.PM1_0;
-	pm2_5 = standard_particle.PM2_5 = pms7003_protocol.standard_particle.PM2_5;
-	pm10  = standard_particle.PM10  = pms7003_protocol.standard_particle.PM10;
-	MUTEX_UNLOCK;
+	pm1_0 = pms7003_protocol.standard_particle.PM1_0;
+	pm2_5 = pms7003_protocol.standard_particle.PM2_5;
+	pm10  = pms7003_protocol.standard_particle.PM10;
+	_update_stats(now, pm2_5, pm10, &fine, &dust);
+	device_state_set_sensor(&pms7003_protocol, &fine, &dust);
+	history_add(time(NULL), &pms7003_protocol.standard_particle);
 
 	/*
 	 * set fan speed : (manual / auto)
@@ -154,29 +312,19 @@ void set_sensor_value(_pms7003_protocol_t pms7003_protocol)
 	if (fan_speed <= MANUAL_FAN_SPEED_HIGH) {
 		INFO("current fan speed = [0x%x]", fan_speed);
 		INFO("Manual fan speed setting is enabled, do nothing");
+		fan_auto_running = false;
 	} else if (fan_speed >= FAN_SPEED_OFF && fan_speed <= FAN_SPEED_HIGH) {
-		// setting fan speed (Auto)
-		/*
-		 * fine dust sensor and fan speed data set
-		 * PM2.5    ~15     ~25     ~50     51~
-		 *          GOOD    NORMAL  POOR    VERY POOR
-		 * fan      OFF     LOW     MEDIUM  HIGH
-		 * manual   0x01    0x02    0x03    0x04
-		 * auto     0x11    0x12    0x13    0x14
-		 *
-		 */
-
-		if ((pm2_5 > FINEDUST_LEVEL_PM2_5_POOR) && (fan_speed != FAN_SPEED_HIGH))
-			set_fan_speed(FAN_SPEED_HIGH);
-		else if (((pm2_5 <= FINEDUST_LEVEL_PM2_5_POOR) && (pm2_5 > FINEDUST_LEVEL_PM2_5_NORMAL))
-				&& (fan_speed != FAN_SPEED_MEDIUM))
-			set_fan_speed(FAN_SPEED_MEDIUM);
-		else if (((pm2_5 <= FINEDUST_LEVEL_PM2_5_NORMAL) && (pm2_5 > FINEDUST_LEVEL_PM2_5_GOOD))
-				&& (fan_speed != FAN_SPEED_LOW))
-			set_fan_speed(FAN_SPEED_LOW);
-		else if ((pm2_5 <= FINEDUST_LEVEL_PM2_5_GOOD)
-				&& (fan_speed != FAN_SPEED_OFF))
-			set_fan_speed(FAN_SPEED_OFF);
+		// setting fan speed (Auto), tiers with hysteresis and dwell time in fan_tiers or PID loop
+		uint32_t next;
+
+		if (!fan_auto_running && fan_pid_enabled)
+			fan_pid_reset(&fan_pid);
+		fan_auto_running = true;
+
+		next = _auto_fan_speed(now_ms, _fan_input(pm2_5, &fine), fan_speed);
+
+		if (next != fan_speed)
+			set_fan_speed(next);
 
 		INFO("current fan speed = [0x%x]", fan_speed);
 	}
@@ -191,51 +339,317 @@ void set_sensor_value(_pms7003_protocol_t pms7003_protocol)
 // get PM10 level
 void get_dust_level(uint32_t *dust_level)
 {
-	MUTEX_LOCK;
-	*dust_level = standard_particle.PM10;
-	MUTEX_UNLOCK;
+	device_state_t state;
+
+	device_state_get(&state);
+	*dust_level = state.standard_particle.PM10;
 }
 
 // get PM2.5 level
 void get_fine_dust_level(uint32_t *fine_dust_level)
 {
-	MUTEX_LOCK;
-	*fine_dust_level = standard_particle.PM2_5;
-	MUTEX_UNLOCK;
+	device_state_t state;
+
+	device_state_get(&state);
+	*fine_dust_level = state.standard_particle.PM2_5;
+}
+
+/*
+ * every closed minute of the history is kept on storage as its mean values
+ */
+static void _history_bucket_cb(history_resolution_e res, const history_aggregate_t *bucket)
+{
+	pm_store_record_t record;
+
+	if (res != HISTORY_RES_MINUTE || bucket->count == 0)
+		return;
+
+	record.time = bucket->time;
+	record.pm1_0 = bucket->pm[0].sum / bucket->count;
+	record.pm2_5 = bucket->pm[1].sum / bucket->count;
+	record.pm10 = bucket->pm[2].sum / bucket->count;
+	pm_store_append(&record);
+}
+
+static void _init_store(void)
+{
+	char *app_data_path = app_get_data_path();
+
+	if (!app_data_path) {
+		ERR("app_data_path is NULL!!");
+		return;
+	}
+
+	if (!pm_store_init(app_data_path))
+		ERR("Failed to open PM store");
+	free(app_data_path);
+
+	history_set_bucket_cb(_history_bucket_cb);
+}
+
+/*
+ * adaptive sampling : next read period of the reader, the publish timer follows it
+ * every decoded frame counts, a rejected outlier may be the start of a pollution event
+ */
+static void _schedule_next_sample(uint32_t pm2_5)
+{
+	device_state_t state;
+	unsigned int interval;
+
+	device_state_get(&state);
+	interval = sampling_scheduler_update(&sampling_scheduler, pm2_5, state.fine_dust_stats.ewma);
+	if (interval == sampling_interval)
+		return;
+
+	DBG("sampling interval %u -> %u s", sampling_interval, interval);
+	sampling_interval = interval;
+	resource_pms7003_reader_set_period(interval * 1000);
+	if (sensor_event_timer)
+		ecore_timer_interval_set(sensor_event_timer, interval > EVENT_INTERVAL_SECOND ? interval : EVENT_INTERVAL_SECOND);
+}
+
+static void _init_sampling(void)
+{
+	const char *mode = getenv(SENSOR_MODE_ENV);
+	sampling_scheduler_config_t config;
+
+	if (!mode)
+		return;
+
+	if (0 == strcmp(mode, "passive")) {
+		resource_pms7003_reader_set_period(EVENT_INTERVAL_SECOND * 1000);
+	} else if (0 == strcmp(mode, "adaptive")) {
+		if (!sampling_scheduler_parse_config(getenv(SAMPLING_ENV), &config)) {
+			ERR("invalid %s, using defaults", SAMPLING_ENV);
+			sampling_scheduler_config_default(&config);
+		}
+		sampling_scheduler_init(&sampling_scheduler, &config);
+		sampling_adaptive = true;
+		sampling_interval = config.min_interval;
+		resource_pms7003_reader_set_period(sampling_interval * 1000);
+		resource_pms7003_reader_set_sleep(config.warmup * 1000);
+	} else {
+		ERR("unknown %s [%s], active mode", SENSOR_MODE_ENV, mode);
+	}
+}
+
+static void _init_drain(void)
+{
+	const char *mode = getenv(DRAIN_ENV);
+
+	if (!mode)
+		return;
+
+	if (0 == strcmp(mode, "latest"))
+		resource_pms7003_reader_set_drain(PMS7003_DRAIN_LATEST);
+	else if (0 == strcmp(mode, "average"))
+		resource_pms7003_reader_set_drain(PMS7003_DRAIN_AVERAGE);
+	else if (0 != strcmp(mode, "off"))
+		ERR("unknown %s [%s], every frame is published", DRAIN_ENV, mode);
+}
+
+// periodic statistics of the reader, fusion, adaptive sampling and auto fan
+static void _log_pipeline_stats(void)
+{
+	static unsigned int ticks = 0;
+	pms7003_reader_stats_t stats;
+
+	if (++ticks % READER_STATS_LOG_PERIOD != 0)
+		return;
+
+	if (!fan_pid_enabled) {
+		fan_controller_stats_t fan;
+
+		fan_controller_get_stats(&fan_controller, &fan);
+		INFO("fan tiers : changes %u, held by the dwell time %u", fan.changes, fan.held);
+	}
+
+	if (sampling_adaptive) {
+		sampling_scheduler_stats_t sampling;
+
+		sampling_scheduler_get_stats(&sampling_scheduler, &sampling);
+		INFO("adaptive sampling : interval %u s, back to the minimum %u, doubled %u",
+				sampling_interval, sampling.speedups, sampling.slowdowns);
+	}
+
+	if (fusion_enabled) {
+		sensor_fusion_stats_t fusion;
+		uint64_t now_ms = _monotonic_ms();
+		unsigned int used = 0;
+		int i;
+
+		for (i = 0; i < resource_pms7003_count(); i++) {
+			if (sensor_fusion_is_used(&sensor_fusion, i, now_ms))
+				used |= 1 << i;
+		}
+
+		sensor_fusion_get_stats(&sensor_fusion, &fusion);
+		INFO("sensor fusion : fused %u, sensors in use 0x%x, left out %u, taken back %u",
+				fusion.fused, used, fusion.exclusions, fusion.inclusions);
+	}
+
+	resource_pms7003_reader_get_stats(&stats);
+	if (stats.delivered == 0)
+		return;
+	INFO("sensor frames : delivered %u, merged %u, age last %u ms, mean %u ms, max %u ms",
+			stats.delivered, stats.merged, stats.last_age_ms,
+			(unsigned int)(stats.total_age_ms / stats.delivered), stats.max_age_ms);
+}
+
+static void _init_fusion(void)
+{
+	sensor_fusion_config_t config;
+	int count = resource_pms7003_count();
+
+	if (count < 2)
+		return;
+
+	if (!sensor_fusion_parse_config(getenv(FUSION_ENV), &config)) {
+		ERR("invalid %s, using defaults", FUSION_ENV);
+		sensor_fusion_config_default(&config);
+	}
+	if (!config.enabled) {
+		INFO("sensor fusion off, publishing sensor 0 of [%d]", count);
+		return;
+	}
+
+	sensor_fusion_init(&sensor_fusion, count, &config);
+	fusion_enabled = true;
+	INFO("sensor fusion of [%d] sensors, %s", count, config.method == SENSOR_FUSION_WEIGHTED ? "weighted" : "median");
+}
+
+/*
+ * called on the main loop by the reader thread wakeup for every decoded frame
+ * the published values and the fan follow the fusion of all sensors, or sensor 0 alone,
+ * every sensor is also published as received
+ */
+static void _sensor_frame_cb(int sensor, const _pms7003_protocol_t *frame, void *user_data)
+{
+	_pms7003_protocol_t fused;
+	UNUSED(user_data);
+
+	device_state_set_sensor_reading(sensor, frame);
+	if (fusion_enabled) {
+		unsigned long frames, checksum_errors;
+
+		resource_pms7003_get_frame_stats(sensor, &frames, &checksum_errors);
+		if (!sensor_fusion_update(&sensor_fusion, sensor, frame, frames, checksum_errors, &fused))
+			return;
+		frame = &fused;
+	} else if (sensor != 0) {
+		return;
+	}
+
+	if (sampling_adaptive)
+		_schedule_next_sample(frame->standard_particle.PM2_5);
+
+	if (!outlier_filter_check(&sensor_filter, frame)) {
+		outlier_filter_stats_t stats;
+
+		outlier_filter_get_stats(&sensor_filter, &stats);
+		WARN("outlier frame dropped [PM1.0: %d | PM2.5: %d | PM10: %d], rejected %u of %u",
+				frame->standard_particle.PM1_0, frame->standard_particle.PM2_5, frame->standard_particle.PM10,
+				stats.rejected, stats.rejected + stats.accepted);
+		return;
+	}
+
+	set_sensor_value(*frame);
+}
+
+static void _init_filter(void)
+{
+	outlier_filter_config_t config;
+
+	if (!outlier_filter_parse_config(getenv(OUTLIER_FILTER_ENV), &config)) {
+		ERR("invalid %s, using defaults", OUTLIER_FILTER_ENV);
+		outlier_filter_config_default(&config);
+	}
+	outlier_filter_init(&sensor_filter, &config);
+}
+
+static void _init_notify_policy(void)
+{
+	notify_policy_config_t config;
+	int i;
+
+	if (!notify_policy_parse_config(getenv(NOTIFY_POLICY_ENV), &config)) {
+		ERR("invalid %s, using defaults", NOTIFY_POLICY_ENV);
+		notify_policy_config_default(&config);
+	}
+	notify_policy_init(&dustsensor_notify, &config);
+	notify_policy_init(&particlesensor_notify, &config);
+	for (i = 1; i < PMS7003_SENSOR_MAX; i++)
+		notify_policy_init(&dustsensor_n_notify[i], &config);
+}
+
+static void _notify_sensor_observers(void)
+{
+	device_state_t state;
+	uint32_t now = _monotonic_seconds();
+	int i;
+
+	device_state_get(&state);
+
+	uint32_t dust[2] = { state.standard_particle.PM2_5, state.standard_particle.PM10 };
+	if (notify_policy_check(&dustsensor_notify, now, dust, 2))
+		st_things_notify_observers(RES_CAPABILITY_DUSTSENSOR_MAIN_0);
+
+	uint32_t particle[3] = { state.standard_particle.PM1_0, state.standard_particle.PM2_5, state.standard_particle.PM10 };
+	if (notify_policy_check(&particlesensor_notify, now, particle, 3))
+		st_things_notify_observers(RES_CAPABILITY_PARTICLESENSOR_MAIN_0);
+
+	for (i = 1; i < resource_pms7003_count(); i++) {
+		uint32_t dust_n[2] = { state.sensors[i].standard_particle.PM2_5, state.sensors[i].standard_particle.PM10 };
+		if (state.sensors[i].arrival_ms && notify_policy_check(&dustsensor_n_notify[i], now, dust_n, 2))
+			st_things_notify_observers(RES_CAPABILITY_DUSTSENSOR_MAIN_N[i]);
+	}
+
+	if (++notify_ticks % NOTIFY_STATS_LOG_PERIOD == 0) {
+		notify_policy_stats_t stats;
+
+		notify_policy_get_stats(&dustsensor_notify, &stats);
+		INFO("dustSensor notifications : sent %u (heartbeat %u), suppressed %u",
+				stats.sent, stats.heartbeats, stats.suppressed);
+	}
 }
 
 static Eina_Bool _sensor_interval_event_cb(void *data)
 {
 	bool switch_status = false;
+	int i;
 
-	// read sensor data from PMS7003 module
-	if (!resource_pms7003_read()) {
-		ERR("resource_pms7003_read Failed");
+	// sensor data is updated by the reader thread, only publish the latest value here
+	#ifndef _DEBUG_PRINT_
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
 
-		// cancel periodic event timer operation
-		return ECORE_CALLBACK_CANCEL;
+	// get sensor value from PMS7003 module
+	uint32_t dust = 0;
+	uint32_t fine = 0;
+	get_dust_level(&dust);			// PM10 level
+	get_fine_dust_level(&fine);		// PM2.5 level
+
+	device_state_t state;
+	device_state_get(&state);
+	INFO("[%d.%06d] dustLevel : %d ug/m3, fineDustLevel : %d ug/m3, age : %lld ms", tv.tv_sec, tv.tv_usec, dust, fine,
+			(long long)device_state_age_ms(state.arrival_ms));
+	#endif
+
+	// send notification when switch is on state.
+	switch_status = _get_switch_status();
+	if (switch_status) {
+		// send notification to cloud server, only when the values changed or the heartbeat is due
+		_notify_sensor_observers();
 	} else {
-		#ifndef _DEBUG_PRINT_
-		struct timeval tv;
-		gettimeofday(&tv, NULL);
-
-		// get sensor value from PMS7003 module
-		uint32_t dust = 0;
-		uint32_t fine = 0;
-		get_dust_level(&dust);			// PM10 level
-		get_fine_dust_level(&fine);		// PM2.5 level
-
-		INFO("[%d.%06d] dustLevel : %d ug/m3, fineDustLevel : %d ug/m3", tv.tv_sec, tv.tv_usec, dust, fine);
-		#endif
-
-		// send notification when switch is on state.
-		switch_status = _get_switch_status();
-		if (switch_status) {
-			// send notification to cloud server
-			st_things_notify_observers(RES_CAPABILITY_DUSTSENSOR_MAIN_0);
-		}
+		// the first tick after switching on notifies right away
+		notify_policy_reset(&dustsensor_notify);
+		notify_policy_reset(&particlesensor_notify);
+		for (i = 1; i < PMS7003_SENSOR_MAX; i++)
+			notify_policy_reset(&dustsensor_n_notify[i]);
 	}
 
+	_log_pipeline_stats();
+
 	// reset next event timer
 	return ECORE_CALLBACK_RENEW;
 }
@@ -253,6 +667,8 @@ static void _clear_timer_resource(void)
 /* handle : for getting request on resources */
 bool handle_get_request(st_things_get_request_message_s *req_msg, st_things_representation_s *resp_rep)
 {
+	int i;
+
 	//DBG("resource_uri [%s]", req_msg->resource_uri);
 
 	if (0 == strcmp(req_msg->resource_uri, RES_CAPABILITY_SWITCH_MAIN_0)) {
@@ -264,6 +680,17 @@ bool handle_get_request(st_things_get_request_message_s *req_msg, st_things_repr
 	if (0 == strcmp(req_msg->resource_uri, RES_CAPABILITY_DUSTSENSOR_MAIN_0)) {
 		return handle_get_request_on_resource_capability_dustsensor(req_msg, resp_rep);
 	}
+	if (0 == strcmp(req_msg->resource_uri, RES_CAPABILITY_PARTICLESENSOR_MAIN_0)) {
+		return handle_get_request_on_resource_capability_particlesensor(req_msg, resp_rep);
+	}
+	if (0 == strcmp(req_msg->resource_uri, RES_HISTORY_DUSTSENSOR_MAIN_0)) {
+		return handle_get_request_on_resource_history_dustsensor(req_msg, resp_rep);
+	}
+	// every declared sensor resource answers, the ones of sensors not configured with present = false
+	for (i = 1; i < PMS7003_SENSOR_MAX; i++) {
+		if (0 == strcmp(req_msg->resource_uri, RES_CAPABILITY_DUSTSENSOR_MAIN_N[i]))
+			return handle_get_request_on_resource_capability_dustsensor_n(i, i < resource_pms7003_count(), req_msg, resp_rep);
+	}
 
 	ERR("not supported uri");
 	return false;
@@ -315,7 +742,20 @@ bool init_user()
 	FN_CALL;
 
 	bool ret = true;
-	_init_mutex();
+	device_state_init(FAN_SPEED_OFF, false);
+	history_init();
+	rolling_stats_init(&fine_dust_stats);
+	rolling_stats_init(&dust_stats);
+	_init_filter();
+	_init_notify_policy();
+	_init_fan_controller();
+	_init_store();
+
+#ifdef PMS7003_BENCHMARK
+	pms7003_bench_run();
+	pms7003_bench_io_run();
+	pms7003_bench_schedule_run();
+#endif
 
 	ret = resource_pms7003_init();
 	if (ret == false) {
@@ -323,6 +763,16 @@ bool init_user()
 		ret = false;
 	}
 
+	_init_sampling();
+	_init_drain();
+	_init_fusion();
+
+	// UART is read on a dedicated thread, frames are delivered to the main loop
+	if (!resource_pms7003_reader_start(_sensor_frame_cb, NULL)) {
+		ERR("Failed to start PMS7003 reader");
+		ret = false;
+	}
+
 	sensor_event_timer = ecore_timer_add(EVENT_INTERVAL_SECOND, _sensor_interval_event_cb, NULL);
 	if (!sensor_event_timer) {
 		ERR("Failed to add sensor_event_timer");
@@ -406,9 +856,11 @@ static void service_app_terminate(void *user_data)
 
 	_clear_timer_resource();
 
+	resource_pms7003_reader_stop();
 	resource_pms7003_fini();
 
-	_deinit_mutex();
+	history_set_bucket_cb(NULL);
+	pm_store_fini();
 }
 
 static void service_app_control(app_control_h app_control, void *user_data)
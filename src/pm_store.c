@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pm_store.h"
+#include "log.h"
+
+#define STORE_BLOCK_MAGIC0		'P'
+#define STORE_BLOCK_MAGIC1		'B'
+#define STORE_HEADER_SIZE		16
+#define STORE_RECORD_MAX_SIZE	14	// varint time [5] + 3 x zigzag varint [3]
+#define STORE_BLOCK_MAX_SIZE	(STORE_HEADER_SIZE + PM_STORE_FLUSH_RECORDS * STORE_RECORD_MAX_SIZE)
+#define STORE_FILE_PREVIOUS		0
+#define STORE_FILE_CURRENT		1
+#define STORE_FILES				2
+
+typedef struct {
+	uint32_t	offset;
+	uint32_t	first_time;
+	uint32_t	last_time;
+} _block_index_t;
+
+typedef struct {
+	char			path[256];
+	int				fd;
+	uint32_t		size;
+	_block_index_t	*index;
+	unsigned int	blocks;
+	unsigned int	capacity;
+} _store_file_t;
+
+static _store_file_t files[STORE_FILES] = { { .fd = -1 }, { .fd = -1 } };
+static pm_store_record_t pending[PM_STORE_FLUSH_RECORDS];
+static unsigned int pending_count = 0;
+static bool initialized = false;
+
+// appends run on the main loop, queries on the request thread
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint16_t _get_le16(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t _get_le32(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void _put_le16(uint8_t *buf, uint16_t val)
+{
+	buf[0] = val & 0xFF;
+	buf[1] = val >> 8;
+}
+
+static void _put_le32(uint8_t *buf, uint32_t val)
+{
+	_put_le16(buf, val & 0xFFFF);
+	_put_le16(buf + 2, val >> 16);
+}
+
+static size_t _put_varint(uint8_t *buf, uint32_t val)
+{
+	size_t len = 0;
+
+	do {
+		buf[len] = val & 0x7F;
+		val >>= 7;
+		if (val)
+			buf[len] |= 0x80;
+		len++;
+	} while (val);
+
+	return len;
+}
+
+static size_t _get_varint(const uint8_t *buf, size_t len, uint32_t *val)
+{
+	size_t pos = 0;
+	int shift = 0;
+
+	*val = 0;
+	while (pos < len && shift < 35) {
+		*val |= (uint32_t)(buf[pos] & 0x7F) << shift;
+		if (!(buf[pos++] & 0x80))
+			return pos;
+		shift += 7;
+	}
+
+	return 0;
+}
+
+static uint32_t _zigzag(int32_t val)
+{
+	return ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+}
+
+static int32_t _unzigzag(uint32_t val)
+{
+	return (int32_t)(val >> 1) ^ -(int32_t)(val & 1);
+}
+
+static uint16_t _payload_check(const uint8_t *payload, size_t len)
+{
+	uint16_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		sum += payload[i];
+
+	return sum;
+}
+
+static bool _index_add(_store_file_t *file, uint32_t offset, uint32_t first_time, uint32_t last_time)
+{
+	if (file->blocks == file->capacity) {
+		unsigned int capacity = file->capacity ? file->capacity * 2 : 64;
+		_block_index_t *index = realloc(file->index, capacity * sizeof(_block_index_t));
+		if (!index) {
+			ERR("out of memory");
+			return false;
+		}
+		file->index = index;
+		file->capacity = capacity;
+	}
+
+	file->index[file->blocks].offset = offset;
+	file->index[file->blocks].first_time = first_time;
+	file->index[file->blocks].last_time = last_time;
+	file->blocks++;
+
+	return true;
+}
+
+/*
+ * open a store file and index its block headers, a torn block at the end is cut off
+ */
+static bool _file_open(_store_file_t *file, const char *path)
+{
+	struct stat st;
+	uint8_t header[STORE_HEADER_SIZE];
+	uint8_t payload[STORE_BLOCK_MAX_SIZE];
+	uint32_t offset = 0;
+
+	snprintf(file->path, sizeof(file->path), "%s", path);
+	file->blocks = 0;
+
+	file->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+	if (file->fd < 0 || fstat(file->fd, &st) != 0) {
+		ERR("store file [%s] open Failed, errno [%d]", path, errno);
+		return false;
+	}
+
+	while (offset + STORE_HEADER_SIZE <= (uint32_t)st.st_size) {
+		uint16_t length = 0;
+
+		if (pread(file->fd, header, STORE_HEADER_SIZE, offset) != STORE_HEADER_SIZE)
+			break;
+
+		length = _get_le16(header + 4);
+		if (header[0] != STORE_BLOCK_MAGIC0 || header[1] != STORE_BLOCK_MAGIC1
+				|| length > STORE_BLOCK_MAX_SIZE - STORE_HEADER_SIZE
+				|| offset + STORE_HEADER_SIZE + length > (uint32_t)st.st_size
+				|| pread(file->fd, payload, length, offset + STORE_HEADER_SIZE) != length
+				|| _payload_check(payload, length) != _get_le16(header + 6))
+			break;
+
+		if (!_index_add(file, offset, _get_le32(header + 8), _get_le32(header + 12)))
+			break;
+		offset += STORE_HEADER_SIZE + length;
+	}
+
+	if (offset != (uint32_t)st.st_size) {
+		WARN("store file [%s] cut at [%u] of [%ld] bytes", path, offset, (long)st.st_size);
+		if (ftruncate(file->fd, offset) != 0)
+			ERR("ftruncate Failed, errno [%d]", errno);
+	}
+
+	file->size = offset;
+	return true;
+}
+
+static void _file_close(_store_file_t *file)
+{
+	if (file->fd >= 0)
+		close(file->fd);
+	free(file->index);
+	file->fd = -1;
+	file->index = NULL;
+	file->blocks = file->capacity = 0;
+	file->size = 0;
+}
+
+/*
+ * the current file is full : it replaces the previous file, a new current file is started
+ */
+static bool _rotate(void)
+{
+	_store_file_t *previous = &files[STORE_FILE_PREVIOUS];
+	_store_file_t *current = &files[STORE_FILE_CURRENT];
+	char path[256];
+
+	INFO("store file [%s] is full, rotate", current->path);
+
+	snprintf(path, sizeof(path), "%s", current->path);
+	if (rename(current->path, previous->path) != 0) {
+		ERR("rename Failed, errno [%d]", errno);
+		return false;
+	}
+
+	_file_close(previous);
+	snprintf(current->path, sizeof(current->path), "%s", previous->path);
+	*previous = *current;
+
+	memset(current, 0, sizeof(_store_file_t));
+	current->fd = -1;
+	return _file_open(current, path);
+}
+
+static size_t _encode_block(uint8_t *block)
+{
+	uint8_t *payload = block + STORE_HEADER_SIZE;
+	pm_store_record_t prev = { pending[0].time, 0, 0, 0 };
+	size_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < pending_count; i++) {
+		const pm_store_record_t *rec = &pending[i];
+
+		len += _put_varint(payload + len, rec->time - prev.time);
+		len += _put_varint(payload + len, _zigzag((int32_t)rec->pm1_0 - prev.pm1_0));
+		len += _put_varint(payload + len, _zigzag((int32_t)rec->pm2_5 - prev.pm2_5));
+		len += _put_varint(payload + len, _zigzag((int32_t)rec->pm10 - prev.pm10));
+		prev = *rec;
+	}
+
+	block[0] = STORE_BLOCK_MAGIC0;
+	block[1] = STORE_BLOCK_MAGIC1;
+	_put_le16(block + 2, pending_count);
+	_put_le16(block + 4, len);
+	_put_le16(block + 6, _payload_check(payload, len));
+	_put_le32(block + 8, pending[0].time);
+	_put_le32(block + 12, pending[pending_count - 1].time);
+
+	return STORE_HEADER_SIZE + len;
+}
+
+static bool _flush_locked(void)
+{
+	_store_file_t *current = &files[STORE_FILE_CURRENT];
+	uint8_t block[STORE_BLOCK_MAX_SIZE];
+	size_t len = 0;
+
+	if (!initialized || pending_count == 0)
+		return true;
+
+	len = _encode_block(block);
+
+	if (current->size + len > PM_STORE_FILE_MAX && !_rotate())
+		return false;
+
+	if (write(current->fd, block, len) != (ssize_t)len) {
+		ERR("store write Failed, errno [%d]", errno);
+		// drop the partial block, it would be cut at the next open anyway
+		if (ftruncate(current->fd, current->size) != 0)
+			ERR("ftruncate Failed, errno [%d]", errno);
+		return false;
+	}
+	fdatasync(current->fd);
+
+	_index_add(current, current->size, pending[0].time, pending[pending_count - 1].time);
+	current->size += len;
+	pending_count = 0;
+
+	return true;
+}
+
+bool pm_store_init(const char *dir)
+{
+	char path[256];
+	bool ret = true;
+
+	pthread_mutex_lock(&store_lock);
+	if (!initialized) {
+		snprintf(path, sizeof(path), "%s/pm_store.1", dir);
+		ret = _file_open(&files[STORE_FILE_PREVIOUS], path);
+
+		snprintf(path, sizeof(path), "%s/pm_store.0", dir);
+		ret = ret && _file_open(&files[STORE_FILE_CURRENT], path);
+
+		if (ret) {
+			INFO("store opened, blocks [%u + %u], size [%u + %u] bytes",
+					files[STORE_FILE_PREVIOUS].blocks, files[STORE_FILE_CURRENT].blocks,
+					files[STORE_FILE_PREVIOUS].size, files[STORE_FILE_CURRENT].size);
+			pending_count = 0;
+			initialized = true;
+		} else {
+			_file_close(&files[STORE_FILE_PREVIOUS]);
+			_file_close(&files[STORE_FILE_CURRENT]);
+		}
+	}
+	pthread_mutex_unlock(&store_lock);
+
+	return ret;
+}
+
+void pm_store_fini(void)
+{
+	pthread_mutex_lock(&store_lock);
+	if (initialized) {
+		_flush_locked();
+		_file_close(&files[STORE_FILE_PREVIOUS]);
+		_file_close(&files[STORE_FILE_CURRENT]);
+		initialized = false;
+	}
+	pthread_mutex_unlock(&store_lock);
+}
+
+bool pm_store_append(const pm_store_record_t *record)
+{
+	bool ret = true;
+
+	pthread_mutex_lock(&store_lock);
+	if (!initialized) {
+		pthread_mutex_unlock(&store_lock);
+		return false;
+	}
+
+	// a clock moving back starts a new block, blocks stay sorted inside
+	if (pending_count > 0 && record->time < pending[pending_count - 1].time)
+		ret = _flush_locked();
+
+	pending[pending_count++] = *record;
+	if (pending_count == PM_STORE_FLUSH_RECORDS)
+		ret = _flush_locked();
+	pthread_mutex_unlock(&store_lock);
+
+	return ret;
+}
+
+bool pm_store_flush(void)
+{
+	bool ret = false;
+
+	pthread_mutex_lock(&store_lock);
+	ret = _flush_locked();
+	pthread_mutex_unlock(&store_lock);
+
+	return ret;
+}
+
+static size_t _decode_block(const uint8_t *block, uint32_t start, uint32_t end, pm_store_record_t *out, size_t max)
+{
+	const uint8_t *payload = block + STORE_HEADER_SIZE;
+	size_t len = _get_le16(block + 4);
+	unsigned int count = _get_le16(block + 2);
+	pm_store_record_t rec = { _get_le32(block + 8), 0, 0, 0 };
+	size_t pos = 0;
+	size_t n = 0;
+	unsigned int i;
+
+	for (i = 0; i < count && n < max; i++) {
+		uint32_t val[4];
+		int c;
+
+		for (c = 0; c < 4; c++) {
+			size_t used = _get_varint(payload + pos, len - pos, &val[c]);
+			if (used == 0)
+				return n;
+			pos += used;
+		}
+
+		rec.time += val[0];
+		rec.pm1_0 += _unzigzag(val[1]);
+		rec.pm2_5 += _unzigzag(val[2]);
+		rec.pm10 += _unzigzag(val[3]);
+
+		if (rec.time > end)
+			break;
+		if (rec.time >= start)
+			out[n++] = rec;
+	}
+
+	return n;
+}
+
+static size_t _query_file(const _store_file_t *file, uint32_t start, uint32_t end, pm_store_record_t *out, size_t max)
+{
+	unsigned int lo = 0, hi = file->blocks;
+	uint8_t *map = NULL;
+	size_t n = 0;
+
+	if (file->blocks == 0 || file->size == 0)
+		return 0;
+
+	// first block ending at or after start
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		if (file->index[mid].last_time < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == file->blocks || file->index[lo].first_time > end)
+		return 0;
+
+	map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+	if (map == MAP_FAILED) {
+		ERR("store mmap Failed, errno [%d]", errno);
+		return 0;
+	}
+
+	for (; lo < file->blocks && n < max && file->index[lo].first_time <= end; lo++)
+		n += _decode_block(map + file->index[lo].offset, start, end, out + n, max - n);
+
+	munmap(map, file->size);
+	return n;
+}
+
+size_t pm_store_query(uint32_t start, uint32_t end, pm_store_record_t *out, size_t max)
+{
+	size_t n = 0;
+	unsigned int i;
+
+	pthread_mutex_lock(&store_lock);
+	if (initialized) {
+		n += _query_file(&files[STORE_FILE_PREVIOUS], start, end, out + n, max - n);
+		n += _query_file(&files[STORE_FILE_CURRENT], start, end, out + n, max - n);
+
+		// records not flushed yet
+		for (i = 0; i < pending_count && n < max; i++) {
+			if (pending[i].time >= start && pending[i].time <= end)
+				out[n++] = pending[i];
+		}
+	}
+	pthread_mutex_unlock(&store_lock);
+
+	return n;
+}
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef PMS7003_BENCHMARK
+
+#define _GNU_SOURCE		// RUSAGE_THREAD
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "resource/pms7003_bench.h"
+#include "resource/pms7003_parser.h"
+#include "resource/pms7003_simulator.h"
+#include "resource/resource_pms7003_reader.h"
+#include "resource/uart_transport.h"
+#include "log.h"
+
+/*
+ * Streams are built from BENCH_FRAMES simulated frames, each decoder runs BENCH_REPEAT times
+ * Reported per decoder and stream :
+ *   frames/s, ns/frame  : decode throughput over valid frames
+ *   discarded           : bytes not delivered as part of a valid frame
+ *   lost/error          : frames lost per injected error
+ */
+
+#define BENCH_FRAMES		10000
+#define BENCH_REPEAT		20
+#define BENCH_SEED			7003
+#define BENCH_MAX_PREFIX	PMS7003_FRAME_SIZE	// garbage bytes before each misaligned frame
+
+typedef struct {
+	const char		*name;
+	unsigned int	noise_per_10000;	// corrupted bytes per 10000
+	bool			misaligned;			// random garbage prefix before every frame
+} _bench_stream_t;
+
+static const _bench_stream_t bench_streams[] = {
+	{ "clean",          0,    false },
+	{ "noise 1%",       100,  false },
+	{ "noise 2%",       200,  false },
+	{ "noise 5%",       500,  false },
+	{ "noise 10%",      1000, false },
+	{ "misaligned",     0,    true },
+};
+
+typedef struct {
+	unsigned long	frames;
+	unsigned long	bytes;
+} _bench_result_t;
+
+/*
+ * baseline : the byte-wise state machine of resource_pms7003_read() before pms7003_parser_t
+ * state is kept in one struct instead of globals, the wire frame_len is clamped to the buffer
+ * (the original wrote past frame_buf on a corrupted length)
+ */
+typedef struct {
+	char			frame_buf[PMS7003_FRAME_SIZE];
+	int				byte_position;
+	int				frame_len;
+	bool			in_frame;
+	unsigned int	calc_checksum;
+	_pms7003_protocol_t	protocol;
+} _legacy_parser_t;
+
+static unsigned long _legacy_feed(_legacy_parser_t *p, const uint8_t *bytes, size_t n)
+{
+	unsigned long frames = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		uint8_t data = bytes[i];
+
+		if (!p->in_frame) {
+			if (data == 0x42 && p->byte_position == 0) {
+				p->frame_buf[p->byte_position++] = data;
+				p->calc_checksum = data;
+			} else if (data == 0x4D && p->byte_position == 1) {
+				p->frame_buf[p->byte_position++] = data;
+				p->calc_checksum += data;
+				p->in_frame = true;
+			}
+			continue;
+		}
+
+		p->frame_buf[p->byte_position] = data;
+		p->calc_checksum += data;
+		p->byte_position++;
+
+		unsigned int val = (p->frame_buf[p->byte_position - 1] & 0xff) + (p->frame_buf[p->byte_position - 2] << 8);
+		switch (p->byte_position) {
+		case 4:
+			p->protocol.frame_len = val;
+			p->frame_len = val + p->byte_position;
+			if (p->frame_len > PMS7003_FRAME_SIZE)
+				p->frame_len = PMS7003_FRAME_SIZE;
+			break;
+		case 6:
+			p->protocol.standard_particle.PM1_0 = val;
+			break;
+		case 8:
+			p->protocol.standard_particle.PM2_5 = val;
+			break;
+		case 10:
+			p->protocol.standard_particle.PM10 = val;
+			break;
+		case 12:
+			p->protocol.atmospheric_env.PM1_0 = val;
+			break;
+		case 14:
+			p->protocol.atmospheric_env.PM2_5 = val;
+			break;
+		case 16:
+			p->protocol.atmospheric_env.PM10 = val;
+			break;
+		case 32:
+			p->protocol.checksum = val;
+			p->calc_checksum -= ((val >> 8) + (val & 0xFF));
+			break;
+		default:
+			break;
+		}
+
+		if (p->byte_position >= p->frame_len) {
+			if (p->byte_position == PMS7003_FRAME_SIZE && p->calc_checksum == p->protocol.checksum)
+				frames++;
+			p->byte_position = 0;
+			p->in_frame = false;
+			memset(&p->protocol, 0, sizeof(_pms7003_protocol_t));
+		}
+	}
+
+	return frames;
+}
+
+static uint64_t _now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * build a stream of BENCH_FRAMES frames, returns its length and the number of injected errors
+ */
+static size_t _bench_build_stream(const _bench_stream_t *stream, uint8_t *buf, unsigned long *errors)
+{
+	unsigned int seed = BENCH_SEED;
+	_pms7003_protocol_t frame;
+	size_t len = 0;
+	int i;
+
+	*errors = 0;
+	for (i = 0; i < BENCH_FRAMES; i++) {
+		if (stream->misaligned) {
+			unsigned int prefix = rand_r(&seed) % BENCH_MAX_PREFIX;
+			while (prefix--)
+				buf[len++] = rand_r(&seed) & 0xFF;
+			(*errors)++;
+		}
+
+		pms7003_simulator_make_frame(5 + rand_r(&seed) % 200, &frame);
+		pms7003_simulator_encode(&frame, buf + len);
+		len += PMS7003_FRAME_SIZE;
+	}
+
+	if (stream->noise_per_10000) {
+		size_t pos;
+		for (pos = 0; pos < len; pos++) {
+			if ((unsigned int)(rand_r(&seed) % 10000) < stream->noise_per_10000) {
+				buf[pos] ^= 1 << (rand_r(&seed) % 8);
+				(*errors)++;
+			}
+		}
+	}
+
+	return len;
+}
+
+static void _bench_report(const char *decoder, const char *stream, uint64_t elapsed_ns,
+		unsigned long frames, size_t len, unsigned long errors)
+{
+	unsigned long lost = BENCH_FRAMES - frames;
+	double ns_per_frame = frames ? (double)elapsed_ns / BENCH_REPEAT / frames : 0.0;
+	double frames_per_sec = elapsed_ns ? (double)frames * BENCH_REPEAT * 1e9 / elapsed_ns : 0.0;
+
+	INFO("[%-8s] %-10s : %10.0f frames/s %8.1f ns/frame, decoded [%lu/%d], discarded [%lu] bytes, lost/error [%.3f]",
+			decoder, stream, frames_per_sec, ns_per_frame, frames, BENCH_FRAMES,
+			(unsigned long)(len - (size_t)frames * PMS7003_FRAME_SIZE),
+			errors ? (double)lost / errors : 0.0);
+}
+
+void pms7003_bench_run(void)
+{
+	size_t max_len = (size_t)BENCH_FRAMES * (PMS7003_FRAME_SIZE + BENCH_MAX_PREFIX);
+	uint8_t *buf = malloc(max_len);
+	_pms7003_protocol_t *frames = malloc(sizeof(_pms7003_protocol_t) * BENCH_FRAMES);
+	unsigned int i;
+	int r;
+
+	if (!buf || !frames) {
+		ERR("out of memory");
+		free(buf);
+		free(frames);
+		return;
+	}
+
+	INFO("----- PMS7003 decoder benchmark : %d frames x %d -----", BENCH_FRAMES, BENCH_REPEAT);
+
+	for (i = 0; i < sizeof(bench_streams) / sizeof(bench_streams[0]); i++) {
+		const _bench_stream_t *stream = &bench_streams[i];
+		unsigned long errors = 0;
+		unsigned long count = 0;
+		size_t len = _bench_build_stream(stream, buf, &errors);
+		uint64_t start = 0;
+
+		// baseline
+		start = _now_ns();
+		for (r = 0; r < BENCH_REPEAT; r++) {
+			_legacy_parser_t legacy;
+			memset(&legacy, 0, sizeof(legacy));
+			legacy.frame_len = PMS7003_FRAME_SIZE;
+			count = _legacy_feed(&legacy, buf, len);
+		}
+		_bench_report("legacy", stream->name, _now_ns() - start, count, len, errors);
+
+		// streaming parser
+		start = _now_ns();
+		for (r = 0; r < BENCH_REPEAT; r++) {
+			pms7003_parser_t parser;
+			size_t consumed = 0;
+			pms7003_parser_init(&parser);
+			count = pms7003_parser_feed(&parser, buf, len, frames, BENCH_FRAMES, &consumed);
+		}
+		_bench_report("parser", stream->name, _now_ns() - start, count, len, errors);
+	}
+
+	free(buf);
+	free(frames);
+}
+
+/*
+ * UART receive loop : simulated sensor in real time on a pseudo-terminal, BENCH_IO_SECONDS per design
+ *   timer : non-blocking read, sleeps BENCH_IO_TIMER_MS when nothing arrived (the former reader)
+ *   event : sleeps in poll() until bytes arrive
+ * Reported per design from getrusage() of the receiving thread :
+ *   wakeups/min     : voluntary and involuntary context switches per minute
+ *   us/frame        : user and system CPU time per decoded frame
+ */
+
+#define BENCH_IO_SECONDS	10
+#define BENCH_IO_TIMER_MS	100
+#define BENCH_IO_BAUD_RATE	9600
+
+static uint64_t _rusage_us(const struct rusage *ru)
+{
+	return (uint64_t)(ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) * 1000000
+			+ ru->ru_utime.tv_usec + ru->ru_stime.tv_usec;
+}
+
+static void _bench_io_design(uart_transport_t *uart, bool event)
+{
+	pms7003_parser_t parser;
+	_pms7003_protocol_t frame;
+	uint8_t bytes[64];
+	struct rusage before, after;
+	unsigned long count = 0;
+	uint64_t start, end, now;
+	long wakeups;
+
+	pms7003_parser_init(&parser);
+	getrusage(RUSAGE_THREAD, &before);
+	start = _now_ns();
+	end = start + (uint64_t)BENCH_IO_SECONDS * 1000000000;
+
+	while ((now = _now_ns()) < end) {
+		size_t consumed = 0;
+		int ret;
+
+		if (event) {
+			ret = uart->ops->poll(uart, (int)((end - now) / 1000000) + 1);
+			if (ret < 0)
+				break;
+			if (ret == 0)
+				continue;
+		}
+
+		ret = uart->ops->read(uart, bytes, sizeof(bytes));
+		if (ret < 0)
+			break;
+		if (ret == 0) {
+			if (!event)
+				usleep(BENCH_IO_TIMER_MS * 1000);
+			continue;
+		}
+
+		while (consumed < (size_t)ret) {
+			size_t used = 0;
+			count += pms7003_parser_feed(&parser, bytes + consumed, ret - consumed, &frame, 1, &used);
+			consumed += used;
+		}
+	}
+
+	getrusage(RUSAGE_THREAD, &after);
+	wakeups = (after.ru_nvcsw - before.ru_nvcsw) + (after.ru_nivcsw - before.ru_nivcsw);
+
+	INFO("[%-5s] %8.1f wakeups/min %8.1f us/frame, decoded [%lu] frames",
+			event ? "event" : "timer",
+			(double)wakeups * 60e9 / (_now_ns() - start),
+			count ? (double)(_rusage_us(&after) - _rusage_us(&before)) / count : 0.0,
+			count);
+}
+
+void pms7003_bench_io_run(void)
+{
+	pms7003_simulator_t sim;
+	pms7003_sim_config_t config;
+	uart_transport_t uart;
+
+	pms7003_simulator_config_default(&config);
+	config.speed = 1.0;
+	memset(&sim, 0, sizeof(sim));
+
+	if (!pms7003_simulator_start(&sim, &config)) {
+		ERR("simulator start failed");
+		return;
+	}
+
+	if (!uart_transport_termios_create(&uart, sim.slave_path) || !uart.ops->open(&uart)) {
+		ERR("UART [%s] open failed", sim.slave_path);
+		pms7003_simulator_stop(&sim);
+		return;
+	}
+
+	if (uart.ops->configure(&uart, BENCH_IO_BAUD_RATE)) {
+		INFO("----- PMS7003 UART receive benchmark : %d s per design -----", BENCH_IO_SECONDS);
+		_bench_io_design(&uart, false);
+		_bench_io_design(&uart, true);
+	} else {
+		ERR("UART [%s] configure failed", sim.slave_path);
+	}
+
+	uart.ops->close(&uart);
+	pms7003_simulator_stop(&sim);
+}
+
+/*
+ * Each step changes the passive period change_ms after a read, the next read is due at once
+ * if the new period already elapsed, one new period after the previous read otherwise
+ * Reported per step : when the next read reached the sensor and when it was due, from the previous read
+ */
+
+#define BENCH_SCHEDULE_START_MS		1000
+#define BENCH_SCHEDULE_TOLERANCE_MS	100	// command transfer and thread wake up
+#define BENCH_SCHEDULE_POLL_US		(5 * 1000)
+#define BENCH_SCHEDULE_TIMEOUT_US	(10 * 1000 * 1000)
+#define BENCH_UART_DEVICE_ENV		"PMS7003_UART_DEVICE"
+
+extern void resource_pms7003_fini(void);
+
+typedef struct {
+	unsigned int	period_ms;		// new period
+	unsigned int	change_ms;		// time after the previous read the period is changed
+} _bench_schedule_step_t;
+
+static const _bench_schedule_step_t bench_schedule_steps[] = {
+	{ 3000, 300 },		// longer : last read + 3000
+	{ 2000, 500 },		// shorter, not elapsed yet : last read + 2000
+	{ 1000, 1500 },		// shorter, already elapsed : at once
+	{ 500,  200 },		// shorter, not elapsed yet : last read + 500
+	{ 1000, 100 },		// longer : last read + 1000
+};
+
+static void _bench_schedule_frame_cb(int sensor, const _pms7003_protocol_t *frame, void *user_data)
+{
+}
+
+// wait until the simulator answered more than reads read commands, returns the time of the last one
+static bool _bench_schedule_wait_read(pms7003_simulator_t *sim, unsigned long reads, uint64_t *read_us)
+{
+	uint64_t deadline = _now_ns() / 1000 + BENCH_SCHEDULE_TIMEOUT_US;
+
+	while (__atomic_load_n(&sim->reads, __ATOMIC_ACQUIRE) <= reads) {
+		if (_now_ns() / 1000 > deadline)
+			return false;
+		usleep(BENCH_SCHEDULE_POLL_US);
+	}
+	*read_us = __atomic_load_n(&sim->last_read_us, __ATOMIC_RELAXED);
+	return true;
+}
+
+static void _bench_schedule_steps(pms7003_simulator_t *sim)
+{
+	unsigned int period = BENCH_SCHEDULE_START_MS;
+	unsigned long reads;
+	uint64_t last_us, read_us, now_us;
+	unsigned int i;
+
+	resource_pms7003_reader_set_period(period);
+	if (!_bench_schedule_wait_read(sim, 0, &last_us)) {
+		ERR("no passive read");
+		return;
+	}
+
+	for (i = 0; i < sizeof(bench_schedule_steps) / sizeof(bench_schedule_steps[0]); i++) {
+		const _bench_schedule_step_t *step = &bench_schedule_steps[i];
+		unsigned int due_ms = step->period_ms > step->change_ms ? step->period_ms : step->change_ms;
+		long error_ms;
+
+		reads = __atomic_load_n(&sim->reads, __ATOMIC_ACQUIRE);
+		now_us = _now_ns() / 1000;
+		if (last_us + step->change_ms * 1000 > now_us)
+			usleep(last_us + step->change_ms * 1000 - now_us);
+		resource_pms7003_reader_set_period(step->period_ms);
+
+		if (!_bench_schedule_wait_read(sim, reads, &read_us)) {
+			ERR("[%4u -> %4u ms] no read after the change", period, step->period_ms);
+			return;
+		}
+		error_ms = (long)((read_us - last_us) / 1000) - (long)due_ms;
+		if (error_ms > BENCH_SCHEDULE_TOLERANCE_MS || error_ms < -BENCH_SCHEDULE_TOLERANCE_MS)
+			ERR("[%4u -> %4u ms] changed at +%u ms, read at +%llu ms, due at +%u ms : off schedule",
+					period, step->period_ms, step->change_ms, (unsigned long long)(read_us - last_us) / 1000, due_ms);
+		else
+			INFO("[%4u -> %4u ms] changed at +%u ms, read at +%llu ms, due at +%u ms",
+					period, step->period_ms, step->change_ms, (unsigned long long)(read_us - last_us) / 1000, due_ms);
+
+		period = step->period_ms;
+		last_us = read_us;
+	}
+}
+
+void pms7003_bench_schedule_run(void)
+{
+	pms7003_simulator_t sim;
+	pms7003_sim_config_t config;
+	char *device = NULL;
+
+	if (getenv("PMS7003_SIMULATOR") || getenv("PMS7003_REPLAY")) {
+		INFO("PMS7003 read schedule check skipped, the sensors are simulated or replayed");
+		return;
+	}
+
+	pms7003_simulator_config_default(&config);
+	config.profile = PMS7003_SIM_PROFILE_CONSTANT;
+	memset(&sim, 0, sizeof(sim));
+
+	if (!pms7003_simulator_start(&sim, &config)) {
+		ERR("simulator start failed");
+		return;
+	}
+
+	// the reader opens the virtual sensor through the termios backend, the configured one is restored after
+	if (getenv(BENCH_UART_DEVICE_ENV))
+		device = strdup(getenv(BENCH_UART_DEVICE_ENV));
+	setenv(BENCH_UART_DEVICE_ENV, sim.slave_path, 1);
+
+	if (resource_pms7003_reader_start(_bench_schedule_frame_cb, NULL)) {
+		INFO("----- PMS7003 passive read schedule check -----");
+		_bench_schedule_steps(&sim);
+		resource_pms7003_reader_stop();
+		resource_pms7003_fini();
+	} else {
+		ERR("reader start failed");
+	}
+	resource_pms7003_reader_set_period(0);
+
+	if (device) {
+		setenv(BENCH_UART_DEVICE_ENV, device, 1);
+		free(device);
+	} else {
+		unsetenv(BENCH_UART_DEVICE_ENV);
+	}
+	pms7003_simulator_stop(&sim);
+}
+
+#endif /* PMS7003_BENCHMARK */
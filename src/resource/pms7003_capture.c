@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "resource/pms7003_capture.h"
+#include "log.h"
+
+#define CAPTURE_FLUSH_RECORDS	64	// batch records before flushing to storage
+
+uint64_t pms7003_capture_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool _put_varint(FILE *fp, uint64_t val)
+{
+	uint8_t buf[10];
+	size_t len = 0;
+
+	do {
+		buf[len] = val & 0x7F;
+		val >>= 7;
+		if (val)
+			buf[len] |= 0x80;
+		len++;
+	} while (val);
+
+	return fwrite(buf, 1, len, fp) == len;
+}
+
+static bool _get_varint(FILE *fp, uint64_t *val)
+{
+	int shift = 0;
+	int c;
+
+	*val = 0;
+	while ((c = fgetc(fp)) != EOF) {
+		*val |= (uint64_t)(c & 0x7F) << shift;
+		if (!(c & 0x80))
+			return true;
+		shift += 7;
+		if (shift >= 64)
+			return false;
+	}
+
+	return false;
+}
+
+bool pms7003_capture_open(pms7003_capture_t *capture, const char *path)
+{
+	memset(capture, 0, sizeof(pms7003_capture_t));
+
+	capture->fp = fopen(path, "ab");
+	if (!capture->fp) {
+		ERR("capture file [%s] open Failed", path);
+		return false;
+	}
+
+	// a new file starts with the header, an appended capture starts with an empty segment record
+	fseek(capture->fp, 0, SEEK_END);
+	if (ftell(capture->fp) == 0) {
+		if (fwrite(PMS7003_CAPTURE_MAGIC, 1, 7, capture->fp) != 7 || fputc(PMS7003_CAPTURE_VERSION, capture->fp) == EOF) {
+			ERR("capture header write Failed");
+			fclose(capture->fp);
+			capture->fp = NULL;
+			return false;
+		}
+	} else if (!_put_varint(capture->fp, 0) || !_put_varint(capture->fp, 0)) {
+		ERR("capture segment write Failed");
+		fclose(capture->fp);
+		capture->fp = NULL;
+		return false;
+	}
+
+	capture->last_us = pms7003_capture_now_us();
+	INFO("capture started [%s]", path);
+	return true;
+}
+
+bool pms7003_capture_write(pms7003_capture_t *capture, const uint8_t *data, size_t len)
+{
+	uint64_t now_us = pms7003_capture_now_us();
+
+	if (!capture->fp)
+		return false;
+
+	if (!_put_varint(capture->fp, now_us - capture->last_us)
+			|| !_put_varint(capture->fp, len)
+			|| fwrite(data, 1, len, capture->fp) != len) {
+		ERR("capture write Failed, capture stopped");
+		pms7003_capture_close(capture);
+		return false;
+	}
+
+	capture->last_us = now_us;
+	capture->records++;
+	capture->bytes += len;
+
+	if (++capture->unflushed >= CAPTURE_FLUSH_RECORDS) {
+		fflush(capture->fp);
+		capture->unflushed = 0;
+	}
+
+	return true;
+}
+
+void pms7003_capture_close(pms7003_capture_t *capture)
+{
+	if (capture->fp) {
+		INFO("capture closed, records [%lu] bytes [%lu]", capture->records, capture->bytes);
+		fclose(capture->fp);
+		capture->fp = NULL;
+	}
+}
+
+static bool _reader_check_header(pms7003_capture_reader_t *reader)
+{
+	char header[PMS7003_CAPTURE_HEADER_SIZE];
+
+	if (fread(header, 1, sizeof(header), reader->fp) != sizeof(header))
+		return false;
+
+	return 0 == memcmp(header, PMS7003_CAPTURE_MAGIC, 7) && header[7] == PMS7003_CAPTURE_VERSION;
+}
+
+bool pms7003_capture_reader_open(pms7003_capture_reader_t *reader, const char *path)
+{
+	memset(reader, 0, sizeof(pms7003_capture_reader_t));
+
+	reader->fp = fopen(path, "rb");
+	if (!reader->fp) {
+		ERR("capture file [%s] open Failed", path);
+		return false;
+	}
+
+	if (!_reader_check_header(reader)) {
+		ERR("[%s] is not a capture file", path);
+		fclose(reader->fp);
+		reader->fp = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+bool pms7003_capture_reader_next(pms7003_capture_reader_t *reader, uint64_t *time_us, uint8_t *data, size_t *len)
+{
+	uint64_t delta_us = 0;
+	uint64_t length = 0;
+
+	if (!reader->fp)
+		return false;
+
+	// empty records mark the start of an appended capture, skip them
+	while (length == 0) {
+		if (!_get_varint(reader->fp, &delta_us) || !_get_varint(reader->fp, &length))
+			return false;
+	}
+	if (length > PMS7003_CAPTURE_CHUNK_MAX) {
+		ERR("corrupted capture record, length [%llu]", (unsigned long long)length);
+		return false;
+	}
+	if (fread(data, 1, length, reader->fp) != length)
+		return false;
+
+	reader->time_us += delta_us;
+	reader->records++;
+
+	*time_us = reader->time_us;
+	*len = length;
+	return true;
+}
+
+void pms7003_capture_reader_close(pms7003_capture_reader_t *reader)
+{
+	if (reader->fp) {
+		fclose(reader->fp);
+		reader->fp = NULL;
+	}
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef PMS7003_FUZZ
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "resource/pms7003_parser.h"
+#include "resource/pms7003_capture.h"
+
+/*
+ * libFuzzer / AFL harness for the PMS7003 frame decoder, built with PMS7003_FUZZ defined
+ *
+ * libFuzzer : clang -g -O1 -fsanitize=fuzzer,address,undefined -DPMS7003_FUZZ -Iinc -I<dlog.h dir>
+ *                 src/resource/pms7003_fuzz.c src/resource/pms7003_parser.c src/resource/pms7003_capture.c
+ * AFL       : afl-clang-fast with -DPMS7003_FUZZ_AFL, the input is read from stdin
+ *
+ * Seed corpus : fuzz/pms7003_corpus, run it with ./pms7003_fuzz fuzz/pms7003_corpus
+ * (AFL : afl-fuzz -i fuzz/pms7003_corpus). It holds mixed data frames and command responses,
+ * corrupted streams and regression inputs of fixed parser bugs.
+ * Capture files recorded on devices with PMS7003_CAPTURE are used as they are,
+ * the harness replays their chunks with the recorded boundaries.
+ * Any other input is a raw byte stream : the first byte selects the chunk size
+ * and how many frames the caller accepts per feed call.
+ *
+ * Checked on every input :
+ *   - the window never grows beyond one frame (asserted by the parser before every append,
+ *     the window is a struct member and ASan does not see an overrun into the next field),
+ *     consumed bytes never exceed the input
+ *   - every input byte is accounted for : frame bytes + discarded bytes + window bytes
+ *   - decoded frames have a valid header and FRAME_LENGTH
+ *   - the work done is bounded by MAX_STEPS_PER_BYTE per input byte
+ */
+
+#define MAX_FRAMES_PER_FEED	4
+#define MAX_STEPS_PER_BYTE	(PMS7003_FRAME_SIZE + 4)
+
+// logs are silenced, the harness does not link dlog
+__attribute__((weak)) int dlog_print(int prio, const char *tag, const char *fmt, ...)
+{
+	return 0;
+}
+
+static void _fuzz_feed(pms7003_parser_t *parser, const uint8_t *data, size_t size, size_t max_frames,
+		unsigned long *fed, unsigned long *frames, unsigned long *frame_bytes)
+{
+	_pms7003_protocol_t out[MAX_FRAMES_PER_FEED];
+
+	while (size > 0) {
+		size_t consumed = 0;
+		size_t count = pms7003_parser_feed(parser, data, size, out, max_frames, &consumed);
+		size_t i;
+
+		assert(count <= max_frames);
+		assert(consumed <= size);
+		assert(consumed > 0 || count > 0);
+		assert(parser->window_len <= PMS7003_FRAME_SIZE);
+
+		for (i = 0; i < count; i++) {
+			assert(out[i].frame_header[0] == PMS7003_START_CHAR1);
+			assert(out[i].frame_header[1] == PMS7003_START_CHAR2);
+			assert(out[i].frame_len == PMS7003_DATA_FRAME_LEN || out[i].frame_len == PMS7003_RESPONSE_FRAME_LEN);
+			*frame_bytes += out[i].frame_len + 4;
+		}
+
+		*fed += consumed;
+		*frames += count;
+		data += consumed;
+		size -= consumed;
+	}
+}
+
+/*
+ * capture file input : feed every record as one received chunk
+ */
+static void _fuzz_capture(pms7003_parser_t *parser, const uint8_t *data, size_t size,
+		unsigned long *fed, unsigned long *frames, unsigned long *frame_bytes)
+{
+	pms7003_capture_reader_t reader;
+	static uint8_t chunk[PMS7003_CAPTURE_CHUNK_MAX];
+	uint64_t time_us = 0;
+	size_t len = 0;
+
+	memset(&reader, 0, sizeof(reader));
+	reader.fp = fmemopen((void *)data, size, "rb");
+	if (!reader.fp)
+		return;
+
+	// skip the header, pms7003_capture_reader_next() parses the records
+	if (fseek(reader.fp, PMS7003_CAPTURE_HEADER_SIZE, SEEK_SET) == 0) {
+		while (pms7003_capture_reader_next(&reader, &time_us, chunk, &len)) {
+			assert(len > 0 && len <= PMS7003_CAPTURE_CHUNK_MAX);
+			_fuzz_feed(parser, chunk, len, MAX_FRAMES_PER_FEED, fed, frames, frame_bytes);
+		}
+	}
+
+	pms7003_capture_reader_close(&reader);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	pms7003_parser_t parser;
+	unsigned long fed = 0;
+	unsigned long frames = 0;
+	unsigned long frame_bytes = 0;
+
+	pms7003_parser_init(&parser);
+
+	if (size >= PMS7003_CAPTURE_HEADER_SIZE && 0 == memcmp(data, PMS7003_CAPTURE_MAGIC, 7)) {
+		_fuzz_capture(&parser, data, size, &fed, &frames, &frame_bytes);
+	} else if (size > 0) {
+		size_t chunk = 1 + (data[0] & 0x3F);
+		size_t max_frames = 1 + ((data[0] >> 6) % MAX_FRAMES_PER_FEED);
+		size_t pos = 1;
+
+		while (pos < size) {
+			size_t len = (size - pos < chunk) ? size - pos : chunk;
+			_fuzz_feed(&parser, data + pos, len, max_frames, &fed, &frames, &frame_bytes);
+			pos += len;
+		}
+	}
+
+	assert(parser.frames == frames);
+	assert(frame_bytes + parser.discarded_bytes + parser.window_len == fed);
+	assert(parser.scan_steps <= MAX_STEPS_PER_BYTE * fed);
+
+	return 0;
+}
+
+#ifdef PMS7003_FUZZ_AFL
+int main(void)
+{
+	static uint8_t buf[1 << 20];
+	size_t size = fread(buf, 1, sizeof(buf), stdin);
+
+	return LLVMFuzzerTestOneInput(buf, size);
+}
+#endif /* PMS7003_FUZZ_AFL */
+
+#endif /* PMS7003_FUZZ */
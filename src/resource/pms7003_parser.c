@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include "resource/pms7003_parser.h"
+
+#define _get_u16(buf, pos)	((uint16_t)(((buf)[pos] << 8) | (buf)[(pos) + 1]))
+
+void pms7003_parser_init(pms7003_parser_t *parser)
+{
+	memset(parser, 0, sizeof(pms7003_parser_t));
+}
+
+void pms7003_parser_reset(pms7003_parser_t *parser)
+{
+	parser->discarded_bytes += parser->window_len;
+	parser->window_len = 0;
+}
+
+size_t pms7003_encode_command(uint8_t cmd, uint16_t data, uint8_t *buf)
+{
+	unsigned int lrc = 0;
+	int i;
+
+	buf[0] = PMS7003_START_CHAR1;
+	buf[1] = PMS7003_START_CHAR2;
+	buf[2] = cmd;
+	buf[3] = data >> 8;
+	buf[4] = data & 0xFF;
+	for (i = 0; i < 5; i++)
+		lrc += buf[i];
+	buf[5] = (lrc >> 8) & 0xFF;
+	buf[6] = lrc & 0xFF;
+
+	return PMS7003_COMMAND_SIZE;
+}
+
+// total size of the frame announced by a validated FRAME_LENGTH field
+static unsigned int _frame_size(const uint8_t *window)
+{
+	return _get_u16(window, 2) + 4;
+}
+
+/*
+ * drop the first byte of the window and slide to the next start character 1 already buffered
+ */
+static void _parser_resync(pms7003_parser_t *parser)
+{
+	unsigned int pos = 1;
+
+	while (pos < parser->window_len && parser->window[pos] != PMS7003_START_CHAR1)
+		pos++;
+
+	parser->discarded_bytes += pos;
+	parser->window_len -= pos;
+	parser->scan_steps += pos + parser->window_len;
+	memmove(parser->window, parser->window + pos, parser->window_len);
+}
+
+/*
+ * Checksum : Check code = START_CHAR1 + START_CHAR2 + data1 + …….. + data13
+ */
+static bool _parser_checksum_ok(const uint8_t *window, unsigned int size)
+{
+	unsigned int calc_checksum = 0;
+	unsigned int i;
+
+	for (i = 0; i < size - 2; i++)
+		calc_checksum += window[i];
+
+	return (calc_checksum & 0xFFFF) == _get_u16(window, size - 2);
+}
+
+static void _parser_decode(const uint8_t *window, _pms7003_protocol_t *frame)
+{
+	memset(frame, 0, sizeof(_pms7003_protocol_t));
+
+	frame->frame_header[0] = window[0];
+	frame->frame_header[1] = window[1];
+	frame->frame_len = _get_u16(window, 2);
+	if (frame->frame_len == PMS7003_RESPONSE_FRAME_LEN) {
+		frame->response_cmd = window[4];
+		frame->response_data = window[5];
+		frame->checksum = _get_u16(window, PMS7003_RESPONSE_FRAME_SIZE - 2);
+		return;
+	}
+	frame->standard_particle.PM1_0 = _get_u16(window, 4);
+	frame->standard_particle.PM2_5 = _get_u16(window, 6);
+	frame->standard_particle.PM10 = _get_u16(window, 8);
+	frame->atmospheric_env.PM1_0 = _get_u16(window, 10);
+	frame->atmospheric_env.PM2_5 = _get_u16(window, 12);
+	frame->atmospheric_env.PM10 = _get_u16(window, 14);
+	frame->particle_count.PC0_3 = _get_u16(window, 16);
+	frame->particle_count.PC0_5 = _get_u16(window, 18);
+	frame->particle_count.PC1_0 = _get_u16(window, 20);
+	frame->particle_count.PC2_5 = _get_u16(window, 22);
+	frame->particle_count.PC5_0 = _get_u16(window, 24);
+	frame->particle_count.PC10 = _get_u16(window, 26);
+	frame->version = window[28];
+	frame->error_code = window[29];
+	frame->checksum = _get_u16(window, PMS7003_FRAME_SIZE - 2);
+}
+
+/*
+ * validate the window from the front, resync until the window is a valid prefix of a frame
+ * returns true when the window holds one complete valid frame
+ */
+static bool _parser_check_window(pms7003_parser_t *parser)
+{
+	while (parser->window_len > 0) {
+		parser->scan_steps++;
+		if (parser->window[0] != PMS7003_START_CHAR1) {
+			_parser_resync(parser);
+			continue;
+		}
+		if (parser->window_len >= 2 && parser->window[1] != PMS7003_START_CHAR2) {
+			_parser_resync(parser);
+			continue;
+		}
+		// do not trust the wire length, the window never grows beyond one frame
+		if (parser->window_len >= 4 && _get_u16(parser->window, 2) != PMS7003_DATA_FRAME_LEN
+				&& _get_u16(parser->window, 2) != PMS7003_RESPONSE_FRAME_LEN) {
+			parser->length_errors++;
+			_parser_resync(parser);
+			continue;
+		}
+		/*
+		 * a resync can land on a header inside the dropped bytes (e.g. a response after a
+		 * truncated data frame) with more bytes buffered than that frame holds,
+		 * the frame is checked on its own bytes and the rest stays buffered behind it
+		 */
+		if (parser->window_len >= 4 && parser->window_len >= _frame_size(parser->window)) {
+			if (_parser_checksum_ok(parser->window, _frame_size(parser->window)))
+				return true;
+
+			parser->checksum_errors++;
+			_parser_resync(parser);
+			continue;
+		}
+
+		// valid prefix, wait for more bytes
+		break;
+	}
+
+	return false;
+}
+
+/*
+ * decode the valid frame at the front of the window, the bytes buffered after it are kept
+ */
+static void _parser_take_frame(pms7003_parser_t *parser, _pms7003_protocol_t *frame)
+{
+	unsigned int size = _frame_size(parser->window);
+
+	_parser_decode(parser->window, frame);
+	parser->frames++;
+	parser->window_len -= size;
+	parser->scan_steps += parser->window_len;
+	memmove(parser->window, parser->window + size, parser->window_len);
+}
+
+size_t pms7003_parser_feed(pms7003_parser_t *parser, const uint8_t *bytes, size_t n,
+		_pms7003_protocol_t *frames, size_t max_frames, size_t *consumed)
+{
+	size_t count = 0;
+	size_t pos = 0;
+
+	// a complete frame stays buffered when the previous call returned max_frames before it
+	while (count < max_frames && _parser_check_window(parser))
+		_parser_take_frame(parser, &frames[count++]);
+
+	while (pos < n && count < max_frames) {
+		// the checks below keep the window within one frame, an overrun stays inside the struct
+		assert(parser->window_len < PMS7003_FRAME_SIZE);
+		parser->window[parser->window_len++] = bytes[pos++];
+
+		// header already validated, nothing to check until the frame is complete
+		if (parser->window_len > 4 && parser->window_len < _frame_size(parser->window))
+			continue;
+
+		// the window is validated before max_frames is checked, a frame left in it is complete
+		while (_parser_check_window(parser) && count < max_frames)
+			_parser_take_frame(parser, &frames[count++]);
+	}
+
+	if (consumed)
+		*consumed = pos;
+
+	return count;
+}
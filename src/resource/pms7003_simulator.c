@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "resource/pms7003_simulator.h"
+#include "resource/pms7003_parser.h"
+#include "config_spec.h"
+#include "log.h"
+
+/*
+ * PMS7003 simulator
+ * Active mode timing follows the sensor : stable mode sends a frame every 2.3s,
+ * fast mode is entered on a big concentration change and sends a frame every 200~800ms,
+ * the higher of the concentration, the shorter of the interval.
+ * In passive mode a frame is sent for each read command only.
+ */
+
+#define STABLE_INTERVAL_MS		2300
+#define FAST_INTERVAL_MIN_MS	200
+#define FAST_INTERVAL_MAX_MS	800
+#define FAST_MODE_MIN_CHANGE	3		// ug/m3, smaller changes never leave stable mode
+#define SLEEP_STEP_MS			100		// stop request is checked every SLEEP_STEP_MS
+
+static uint64_t _sim_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static unsigned int _sim_rand(pms7003_simulator_t *sim, unsigned int range)
+{
+	if (range == 0)
+		return 0;
+	return rand_r(&sim->rand_state) % range;
+}
+
+void pms7003_simulator_config_default(pms7003_sim_config_t *config)
+{
+	memset(config, 0, sizeof(pms7003_sim_config_t));
+	config->profile = PMS7003_SIM_PROFILE_WAVE;
+	config->base = 10;
+	config->amplitude = 40;
+	config->period_ms = 10 * 60 * 1000;
+	config->speed = 1.0;
+	config->seed = 1;
+}
+
+static bool _parse_profile(void *field, const char *value)
+{
+	static const char *names[] = {
+		[PMS7003_SIM_PROFILE_CONSTANT] = "constant",
+		[PMS7003_SIM_PROFILE_WAVE] = "wave",
+		[PMS7003_SIM_PROFILE_STEP] = "step",
+		[PMS7003_SIM_PROFILE_RAMP] = "ramp",
+		[PMS7003_SIM_PROFILE_RANDOM_WALK] = "walk",
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (0 == strcmp(value, names[i])) {
+			*(pms7003_sim_profile_e *)field = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static const config_spec_option_t sim_options[] = {
+	CONFIG_SPEC_OPTION("profile", _parse_profile, pms7003_sim_config_t, profile),
+	CONFIG_SPEC_OPTION("base", config_spec_uint, pms7003_sim_config_t, base),
+	CONFIG_SPEC_OPTION("amp", config_spec_uint, pms7003_sim_config_t, amplitude),
+	CONFIG_SPEC_OPTION("period", config_spec_uint, pms7003_sim_config_t, period_ms),
+	CONFIG_SPEC_OPTION("spike", config_spec_uint, pms7003_sim_config_t, spike_permille),
+	CONFIG_SPEC_OPTION("noise", config_spec_uint, pms7003_sim_config_t, noise_per_10000),
+	CONFIG_SPEC_OPTION("trunc", config_spec_uint, pms7003_sim_config_t, truncate_permille),
+	CONFIG_SPEC_OPTION("cksum", config_spec_uint, pms7003_sim_config_t, checksum_permille),
+	CONFIG_SPEC_OPTION("speed", config_spec_double, pms7003_sim_config_t, speed),
+	CONFIG_SPEC_OPTION("seed", config_spec_uint, pms7003_sim_config_t, seed),
+};
+
+bool pms7003_simulator_parse_config(const char *spec, pms7003_sim_config_t *config)
+{
+	bool ret;
+
+	pms7003_simulator_config_default(config);
+	ret = config_spec_parse(spec, "simulator", sim_options, sizeof(sim_options) / sizeof(sim_options[0]), config);
+
+	if (config->period_ms == 0)
+		config->period_ms = 1;
+
+	return ret;
+}
+
+void pms7003_simulator_make_frame(unsigned int pm2_5, _pms7003_protocol_t *frame)
+{
+	memset(frame, 0, sizeof(_pms7003_protocol_t));
+
+	frame->standard_particle.PM1_0 = pm2_5 * 7 / 10;
+	frame->standard_particle.PM2_5 = pm2_5;
+	frame->standard_particle.PM10 = pm2_5 * 13 / 10;
+
+	// standard particle and atmospheric values are equal at low concentration
+	frame->atmospheric_env.PM1_0 = frame->standard_particle.PM1_0 * 2 / 3;
+	frame->atmospheric_env.PM2_5 = pm2_5 * 2 / 3;
+	frame->atmospheric_env.PM10 = frame->standard_particle.PM10 * 2 / 3;
+	if (pm2_5 < 30)
+		frame->atmospheric_env = frame->standard_particle;
+
+	frame->particle_count.PC0_3 = pm2_5 * 150;
+	frame->particle_count.PC0_5 = pm2_5 * 45;
+	frame->particle_count.PC1_0 = pm2_5 * 8;
+	frame->particle_count.PC2_5 = pm2_5 / 2;
+	frame->particle_count.PC5_0 = pm2_5 / 8;
+	frame->particle_count.PC10 = pm2_5 / 20;
+	frame->version = 0x80;
+}
+
+static void _put_u16(uint8_t *buf, unsigned int pos, uint16_t val)
+{
+	buf[pos] = val >> 8;
+	buf[pos + 1] = val & 0xFF;
+}
+
+void pms7003_simulator_encode(const _pms7003_protocol_t *frame, uint8_t *buf)
+{
+	unsigned int checksum = 0;
+	int i;
+
+	buf[0] = PMS7003_START_CHAR1;
+	buf[1] = PMS7003_START_CHAR2;
+	_put_u16(buf, 2, PMS7003_DATA_FRAME_LEN);
+	_put_u16(buf, 4, frame->standard_particle.PM1_0);
+	_put_u16(buf, 6, frame->standard_particle.PM2_5);
+	_put_u16(buf, 8, frame->standard_particle.PM10);
+	_put_u16(buf, 10, frame->atmospheric_env.PM1_0);
+	_put_u16(buf, 12, frame->atmospheric_env.PM2_5);
+	_put_u16(buf, 14, frame->atmospheric_env.PM10);
+	_put_u16(buf, 16, frame->particle_count.PC0_3);
+	_put_u16(buf, 18, frame->particle_count.PC0_5);
+	_put_u16(buf, 20, frame->particle_count.PC1_0);
+	_put_u16(buf, 22, frame->particle_count.PC2_5);
+	_put_u16(buf, 24, frame->particle_count.PC5_0);
+	_put_u16(buf, 26, frame->particle_count.PC10);
+	buf[28] = frame->version;
+	buf[29] = frame->error_code;
+
+	for (i = 0; i < PMS7003_FRAME_SIZE - 2; i++)
+		checksum += buf[i];
+	_put_u16(buf, PMS7003_FRAME_SIZE - 2, checksum & 0xFFFF);
+}
+
+static unsigned int _sim_concentration(pms7003_simulator_t *sim)
+{
+	const pms7003_sim_config_t *config = &sim->config;
+	unsigned int phase = sim->sim_time_ms % config->period_ms;
+	unsigned int half = config->period_ms / 2;
+	unsigned int max = config->base + config->amplitude;
+	int step = 0;
+
+	switch (config->profile) {
+	case PMS7003_SIM_PROFILE_WAVE:
+		if (half == 0)
+			return config->base;
+		if (phase < half)
+			return config->base + (uint64_t)config->amplitude * phase / half;
+		return max - (uint64_t)config->amplitude * (phase - half) / (config->period_ms - half);
+	case PMS7003_SIM_PROFILE_STEP:
+		return (phase < half) ? config->base : max;
+	case PMS7003_SIM_PROFILE_RAMP:
+		return config->base + (uint64_t)config->amplitude * phase / config->period_ms;
+	case PMS7003_SIM_PROFILE_RANDOM_WALK:
+		step = config->amplitude / 10 + 1;
+		step = (int)_sim_rand(sim, 2 * step + 1) - step;
+		if ((int)sim->last_pm2_5 + step < 0)
+			return 0;
+		if (sim->last_pm2_5 + step > max)
+			return max;
+		return sim->last_pm2_5 + step;
+	case PMS7003_SIM_PROFILE_CONSTANT:
+	default:
+		return config->base;
+	}
+}
+
+/*
+ * write all bytes to the pty master, waits while the slave side does not read
+ */
+static bool _sim_write(pms7003_simulator_t *sim, const uint8_t *buf, size_t len)
+{
+	size_t written = 0;
+
+	while (written < len) {
+		ssize_t ret = write(sim->master_fd, buf + written, len - written);
+		if (ret > 0) {
+			written += ret;
+			continue;
+		}
+		if (ret < 0 && errno != EAGAIN && errno != EINTR) {
+			ERR("simulator write failed, errno [%d]", errno);
+			return false;
+		}
+		if (__atomic_load_n(&sim->stop, __ATOMIC_ACQUIRE))
+			return false;
+
+		struct pollfd pfd = { .fd = sim->master_fd, .events = POLLOUT };
+		poll(&pfd, 1, SLEEP_STEP_MS);
+	}
+
+	return true;
+}
+
+/*
+ * one frame at the current simulated concentration, with the configured faults
+ * interval_ms is set to the active mode interval to the next frame
+ */
+static bool _sim_send_frame(pms7003_simulator_t *sim, unsigned int *interval_ms)
+{
+	const pms7003_sim_config_t *config = &sim->config;
+	_pms7003_protocol_t frame;
+	uint8_t buf[PMS7003_FRAME_SIZE];
+	unsigned int pm2_5 = _sim_concentration(sim);
+	unsigned int change = (pm2_5 > sim->last_pm2_5) ? pm2_5 - sim->last_pm2_5 : sim->last_pm2_5 - pm2_5;
+	size_t len = PMS7003_FRAME_SIZE;
+	size_t i;
+
+	*interval_ms = STABLE_INTERVAL_MS;
+
+	// fast mode on a big change, the higher of the concentration, the shorter of the interval
+	if (change >= FAST_MODE_MIN_CHANGE && change * 10 >= sim->last_pm2_5) {
+		unsigned int level = (pm2_5 > 300) ? 300 : pm2_5;
+		*interval_ms = FAST_INTERVAL_MAX_MS - (FAST_INTERVAL_MAX_MS - FAST_INTERVAL_MIN_MS) * level / 300;
+		sim->fast_mode_frames++;
+	}
+	sim->last_pm2_5 = pm2_5;
+
+	if (_sim_rand(sim, 1000) < config->spike_permille) {
+		pm2_5 = 4 * (config->base + config->amplitude) + 1;
+		sim->spikes++;
+	}
+
+	pms7003_simulator_make_frame(pm2_5, &frame);
+	pms7003_simulator_encode(&frame, buf);
+
+	if (_sim_rand(sim, 1000) < config->checksum_permille) {
+		buf[PMS7003_FRAME_SIZE - 1] ^= 0x5A;
+		sim->checksum_errors++;
+	}
+	if (_sim_rand(sim, 1000) < config->truncate_permille) {
+		len = 1 + _sim_rand(sim, PMS7003_FRAME_SIZE - 1);
+		sim->truncated_frames++;
+	}
+	for (i = 0; i < len; i++) {
+		if (_sim_rand(sim, 10000) < config->noise_per_10000) {
+			buf[i] ^= 1 << _sim_rand(sim, 8);
+			sim->corrupted_bytes++;
+		}
+	}
+
+	if (!_sim_write(sim, buf, len))
+		return false;
+	sim->frames_sent++;
+	return true;
+}
+
+static bool _sim_send_response(pms7003_simulator_t *sim, uint8_t cmd, uint8_t data)
+{
+	uint8_t buf[PMS7003_RESPONSE_FRAME_SIZE] = {
+		PMS7003_START_CHAR1, PMS7003_START_CHAR2, 0x00, PMS7003_RESPONSE_FRAME_LEN, cmd, data, 0, 0
+	};
+	unsigned int checksum = 0;
+	int i;
+
+	for (i = 0; i < PMS7003_RESPONSE_FRAME_SIZE - 2; i++)
+		checksum += buf[i];
+	buf[6] = (checksum >> 8) & 0xFF;
+	buf[7] = checksum & 0xFF;
+
+	return _sim_write(sim, buf, sizeof(buf));
+}
+
+static bool _sim_execute(pms7003_simulator_t *sim, uint8_t cmd, uint16_t data)
+{
+	unsigned int interval_ms = 0;
+
+	sim->commands++;
+	switch (cmd) {
+	case PMS7003_CMD_MODE:
+		sim->passive = (data == PMS7003_MODE_PASSIVE);
+		return _sim_send_response(sim, cmd, data & 0xFF);
+	case PMS7003_CMD_READ:
+		if (!sim->passive || sim->sleeping)
+			return true;
+		__atomic_store_n(&sim->last_read_us, _sim_now_us(), __ATOMIC_RELAXED);
+		__atomic_add_fetch(&sim->reads, 1, __ATOMIC_RELEASE);
+		return _sim_send_frame(sim, &interval_ms);
+	case PMS7003_CMD_SLEEP:
+		if (data == PMS7003_WAKEUP) {
+			sim->sleeping = false;
+			return true;
+		}
+		sim->sleeping = true;
+		return _sim_send_response(sim, cmd, data & 0xFF);
+	default:
+		return true;
+	}
+}
+
+/*
+ * read host commands from the pty master, complete commands with a valid LRC are executed
+ */
+static bool _sim_read_commands(pms7003_simulator_t *sim)
+{
+	uint8_t buf[64];
+	ssize_t ret;
+	ssize_t i;
+
+	while ((ret = read(sim->master_fd, buf, sizeof(buf))) > 0) {
+		for (i = 0; i < ret; i++) {
+			// resync on the start characters
+			if ((sim->cmd_len == 0 && buf[i] != PMS7003_START_CHAR1)
+					|| (sim->cmd_len == 1 && buf[i] != PMS7003_START_CHAR2)) {
+				sim->cmd_len = (buf[i] == PMS7003_START_CHAR1) ? 1 : 0;
+				if (sim->cmd_len)
+					sim->cmd_buf[0] = buf[i];
+				continue;
+			}
+			sim->cmd_buf[sim->cmd_len++] = buf[i];
+			if (sim->cmd_len < PMS7003_COMMAND_SIZE)
+				continue;
+
+			sim->cmd_len = 0;
+			unsigned int lrc = 0;
+			int k;
+			for (k = 0; k < 5; k++)
+				lrc += sim->cmd_buf[k];
+			if (lrc != (unsigned int)((sim->cmd_buf[5] << 8) | sim->cmd_buf[6]))
+				continue;
+			if (!_sim_execute(sim, sim->cmd_buf[2], (sim->cmd_buf[3] << 8) | sim->cmd_buf[4]))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * wait interval_ms of simulated time, host commands are served meanwhile
+ */
+static void _sim_sleep(pms7003_simulator_t *sim, unsigned int interval_ms)
+{
+	uint64_t sleep_us = 0;
+	struct pollfd pfd = { .fd = sim->master_fd, .events = POLLIN };
+
+	if (sim->config.speed <= 0.0) {
+		_sim_read_commands(sim);
+		return;
+	}
+
+	sleep_us = (uint64_t)(interval_ms * 1000.0 / sim->config.speed);
+	while (sleep_us > 0 && !__atomic_load_n(&sim->stop, __ATOMIC_ACQUIRE)) {
+		uint64_t step = (sleep_us > SLEEP_STEP_MS * 1000) ? SLEEP_STEP_MS * 1000 : sleep_us;
+		uint64_t begin = _sim_now_us();
+		uint64_t elapsed;
+
+		if (poll(&pfd, 1, (step + 999) / 1000) > 0 && !_sim_read_commands(sim))
+			return;
+
+		elapsed = _sim_now_us() - begin;
+		sleep_us -= (elapsed < sleep_us) ? elapsed : sleep_us;
+	}
+}
+
+static void *_sim_thread_func(void *data)
+{
+	pms7003_simulator_t *sim = data;
+
+	INFO("----- PMS7003 simulator started [%s] -----", sim->slave_path);
+
+	while (!__atomic_load_n(&sim->stop, __ATOMIC_ACQUIRE)) {
+		unsigned int interval_ms = STABLE_INTERVAL_MS;
+
+		// passive or sleeping : frames are sent on commands only, simulated time goes on
+		if (sim->passive || sim->sleeping) {
+			interval_ms = SLEEP_STEP_MS;
+			sim->sim_time_ms += interval_ms;
+			if (sim->config.speed <= 0.0) {
+				struct pollfd pfd = { .fd = sim->master_fd, .events = POLLIN };
+				poll(&pfd, 1, SLEEP_STEP_MS);
+			}
+			_sim_sleep(sim, interval_ms);
+			continue;
+		}
+
+		if (!_sim_send_frame(sim, &interval_ms))
+			break;
+
+		sim->sim_time_ms += interval_ms;
+		_sim_sleep(sim, interval_ms);
+	}
+
+	INFO("----- PMS7003 simulator stopped : frames [%lu] fast [%lu] spikes [%lu] noise bytes [%lu] truncated [%lu] checksum errors [%lu] commands [%lu] -----",
+			sim->frames_sent, sim->fast_mode_frames, sim->spikes, sim->corrupted_bytes, sim->truncated_frames, sim->checksum_errors,
+			sim->commands);
+	return NULL;
+}
+
+bool pms7003_simulator_start(pms7003_simulator_t *sim, const pms7003_sim_config_t *config)
+{
+	struct termios tio;
+	const char *slave = NULL;
+
+	memset(sim, 0, sizeof(pms7003_simulator_t));
+	sim->config = *config;
+	sim->rand_state = config->seed;
+	sim->last_pm2_5 = config->base;
+
+	sim->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (sim->master_fd < 0) {
+		ERR("posix_openpt Failed, errno [%d]", errno);
+		return false;
+	}
+	if (grantpt(sim->master_fd) != 0 || unlockpt(sim->master_fd) != 0 || !(slave = ptsname(sim->master_fd))) {
+		ERR("pty setup Failed, errno [%d]", errno);
+		close(sim->master_fd);
+		return false;
+	}
+	snprintf(sim->slave_path, sizeof(sim->slave_path), "%s", slave);
+
+	// binary data : no line discipline processing on the master side
+	if (tcgetattr(sim->master_fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(sim->master_fd, TCSANOW, &tio);
+	}
+
+	if (pthread_create(&sim->thread, NULL, _sim_thread_func, sim) != 0) {
+		ERR("Failed to create simulator thread");
+		close(sim->master_fd);
+		return false;
+	}
+
+	sim->running = true;
+	return true;
+}
+
+void pms7003_simulator_stop(pms7003_simulator_t *sim)
+{
+	if (!sim->running) return;
+
+	__atomic_store_n(&sim->stop, true, __ATOMIC_RELEASE);
+	pthread_join(sim->thread, NULL);
+	close(sim->master_fd);
+	sim->master_fd = -1;
+	sim->running = false;
+}
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <Ecore.h>
+#include "resource/resource_pms7003_reader.h"
+#include "log.h"
+
+/*
+ * PMS7003 reader thread
+ * The reader thread owns the UARTs of all sensors. In active mode it sleeps in poll() until
+ * any of them received data and decodes only what arrived, it never blocks on one sensor while
+ * another one has data and does not wake up while no data arrives. Configuration changes and
+ * the stop request wake it up through the driver wake up pipe.
+ * Decoded frames are handed over to the Ecore main loop through a
+ * single-producer/single-consumer ring and an Ecore pipe is used to wake up the main loop,
+ * so GET/SET request handling never waits on sensor I/O.
+ * In passive mode the reader thread requests one frame per period from each sensor and sleeps
+ * in between, the sensors send nothing that is not used. With long periods the sensors
+ * themselves sleep (laser and fan off) and are woken the warm-up time before the next read.
+ * In active mode with draining enabled the reader thread decodes everything already received
+ * and hands over only the newest frame of each sensor, the main loop keeps only the newest
+ * queued frame of each sensor, so the published value is never older than one read cycle.
+ */
+
+#define FRAME_QUEUE_SIZE		32				// must be a power of 2
+#define READ_RETRY_DELAY_US		(100 * 1000)	// back off after a failed read
+#define PERIOD_UNSET			((unsigned int)-1)
+#define SLEEP_MIN_MS			(10 * 1000)		// shorter sleeps are not worth a wake up
+
+typedef struct {
+	int					sensor;		// sensor id, 0 ~ PMS7003_SENSOR_MAX - 1
+	_pms7003_protocol_t	frame;
+	unsigned int		merged;		// older frames folded into this one
+} _frame_slot_t;
+
+// single-producer (reader thread) / single-consumer (main loop) frame ring
+typedef struct {
+	_frame_slot_t		frames[FRAME_QUEUE_SIZE];
+	unsigned int		head;	// next slot to write, updated by the reader thread only
+	unsigned int		tail;	// next slot to read, updated by the main loop only
+} _frame_queue_t;
+
+static _frame_queue_t frame_queue;
+static unsigned int dropped_frames = 0;	// frames dropped because the ring was full
+
+static Ecore_Pipe *wakeup_pipe = NULL;
+static pthread_t reader_thread;
+static bool reader_running = false;
+static bool reader_stop = false;
+
+static pms7003_frame_cb g_frame_cb = NULL;
+static void *g_frame_cb_data = NULL;
+
+// requested passive read period, 0 : active mode, written by the main loop
+static unsigned int passive_period_ms = 0;
+// sensor warm-up after wake up, 0 : the sensor never sleeps, written by the main loop
+static unsigned int sleep_warmup_ms = 0;
+// active mode frame draining, written by the main loop
+static pms7003_drain_e drain_mode = PMS7003_DRAIN_OFF;
+
+// age of delivered frames, main loop only
+static pms7003_reader_stats_t reader_stats;
+
+extern bool resource_pms7003_init(void);
+extern int resource_pms7003_count(void);
+extern bool resource_pms7003_is_open(int id);
+extern int resource_pms7003_wait(uint32_t *ready, int timeout_ms);
+extern int resource_pms7003_read_nowait(int id, _pms7003_protocol_t *frame);
+extern int resource_pms7003_read_latest(int id, _pms7003_protocol_t *frame, bool average, unsigned int *drained);
+extern void resource_pms7003_cancel(void);
+extern void resource_pms7003_wakeup(void);
+extern bool resource_pms7003_sleep(int timeout_ms);
+extern bool resource_pms7003_set_passive(int id, bool passive);
+extern bool resource_pms7003_request_read(int id, _pms7003_protocol_t *frame);
+extern bool resource_pms7003_set_sleep(int id, bool sleep);
+
+static bool _frame_queue_push(_frame_queue_t *queue, const _frame_slot_t *frame)
+{
+	unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= FRAME_QUEUE_SIZE)
+		return false;
+
+	queue->frames[head & (FRAME_QUEUE_SIZE - 1)] = *frame;
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static bool _frame_queue_pop(_frame_queue_t *queue, _frame_slot_t *frame)
+{
+	unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+	if (tail == head)
+		return false;
+
+	*frame = queue->frames[tail & (FRAME_QUEUE_SIZE - 1)];
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static uint64_t _now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void _deliver(const _frame_slot_t *slot)
+{
+	uint64_t now = _now_ms();
+	uint32_t age = (now > slot->frame.arrival_ms) ? (uint32_t)(now - slot->frame.arrival_ms) : 0;
+
+	reader_stats.delivered++;
+	reader_stats.merged += slot->merged;
+	reader_stats.last_age_ms = age;
+	reader_stats.total_age_ms += age;
+	if (age > reader_stats.max_age_ms)
+		reader_stats.max_age_ms = age;
+
+	if (g_frame_cb)
+		g_frame_cb(slot->sensor, &slot->frame, g_frame_cb_data);
+}
+
+/*
+ * runs on the Ecore main loop : drain every queued frame,
+ * with draining enabled only the newest one of each sensor is delivered
+ */
+static void _wakeup_pipe_cb(void *data, void *buffer, unsigned int nbyte)
+{
+	_frame_slot_t slot;
+	_frame_slot_t latest[PMS7003_SENSOR_MAX];
+	bool queued[PMS7003_SENSOR_MAX] = { false, };
+	int i;
+
+	if (__atomic_load_n(&drain_mode, __ATOMIC_RELAXED) == PMS7003_DRAIN_OFF) {
+		while (_frame_queue_pop(&frame_queue, &slot))
+			_deliver(&slot);
+		return;
+	}
+
+	while (_frame_queue_pop(&frame_queue, &slot)) {
+		if (queued[slot.sensor])
+			slot.merged += latest[slot.sensor].merged + 1;
+		latest[slot.sensor] = slot;
+		queued[slot.sensor] = true;
+	}
+	for (i = 0; i < PMS7003_SENSOR_MAX; i++) {
+		if (queued[i])
+			_deliver(&latest[i]);
+	}
+}
+
+static bool _reader_push(const _frame_slot_t *slot)
+{
+	if (!_frame_queue_push(&frame_queue, slot)) {
+		dropped_frames++;
+		WARN("frame queue is full, dropped frames [%u]", dropped_frames);
+		return false;
+	}
+	return true;
+}
+
+// sleep until deadline_ms, returns early when the reader is stopped or the period changed
+static void _reader_wait_until(uint64_t deadline_ms, unsigned int period_ms)
+{
+	uint64_t now;
+
+	while (!__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE)
+			&& __atomic_load_n(&passive_period_ms, __ATOMIC_ACQUIRE) == period_ms
+			&& (now = _now_ms()) < deadline_ms) {
+		// woken by a period change or the stop request
+		resource_pms7003_sleep((int)(deadline_ms - now));
+	}
+}
+
+/*
+ * switch every open sensor to passive or active mode
+ * passive mode is used only if all of them acknowledged it, otherwise they all stay active
+ */
+static bool _reader_set_passive(int count, bool passive)
+{
+	bool acked = true;
+	int id;
+
+	for (id = 0; id < count; id++) {
+		if (resource_pms7003_is_open(id) && !resource_pms7003_set_passive(id, passive))
+			acked = false;
+	}
+	if (!passive || acked)
+		return passive;
+
+	WARN("passive mode not acknowledged, listening in active mode");
+	for (id = 0; id < count; id++) {
+		if (resource_pms7003_is_open(id))
+			resource_pms7003_set_passive(id, false);
+	}
+	return false;
+}
+
+/*
+ * sleep the sensors until their warm-up time before next_read_ms when the gap allows it
+ */
+static void _reader_sleep_sensors(int count, uint64_t next_read_ms, unsigned int period_ms)
+{
+	unsigned int warmup = __atomic_load_n(&sleep_warmup_ms, __ATOMIC_ACQUIRE);
+	uint64_t wake_ms = next_read_ms - warmup;
+	bool asleep = false;
+	int id;
+
+	if (warmup == 0 || next_read_ms < warmup || _now_ms() + SLEEP_MIN_MS > wake_ms)
+		return;
+	for (id = 0; id < count; id++) {
+		if (resource_pms7003_is_open(id) && resource_pms7003_set_sleep(id, true))
+			asleep = true;
+	}
+	if (!asleep)
+		return;
+
+	_reader_wait_until(wake_ms, period_ms);
+	for (id = 0; id < count; id++) {
+		if (!resource_pms7003_is_open(id))
+			continue;
+		resource_pms7003_set_sleep(id, false);
+		// the sensor restarts on wake up, make sure it is still in passive mode
+		resource_pms7003_set_passive(id, true);
+	}
+}
+
+/*
+ * passive mode : request one frame from every sensor, returns true if any frame was queued
+ */
+static bool _reader_request_frames(int count)
+{
+	_frame_slot_t slot = { .merged = 0 };
+	bool queued = false;
+
+	for (slot.sensor = 0; slot.sensor < count; slot.sensor++) {
+		if (!resource_pms7003_is_open(slot.sensor))
+			continue;
+		if (resource_pms7003_request_read(slot.sensor, &slot.frame) && _reader_push(&slot))
+			queued = true;
+	}
+	return queued;
+}
+
+/*
+ * active mode : wait until any sensor received data and decode it, returns true if any frame was queued
+ */
+static bool _reader_read_frames(void)
+{
+	pms7003_drain_e drain = __atomic_load_n(&drain_mode, __ATOMIC_RELAXED);
+	_frame_slot_t slot = { .merged = 0 };
+	uint32_t ready = 0;
+	bool queued = false;
+	int ret;
+
+	// sleeps until bytes arrive or the configuration changes
+	ret = resource_pms7003_wait(&ready, -1);
+	if (ret < 0) {
+		usleep(READ_RETRY_DELAY_US);
+		return false;
+	}
+
+	for (slot.sensor = 0; ready; slot.sensor++, ready >>= 1) {
+		if (!(ready & 1))
+			continue;
+
+		if (drain != PMS7003_DRAIN_OFF) {
+			// skip to the newest frame already received
+			ret = resource_pms7003_read_latest(slot.sensor, &slot.frame, drain == PMS7003_DRAIN_AVERAGE, &slot.merged);
+			if (ret > 0) {
+				slot.merged--;
+				queued |= _reader_push(&slot);
+			} else if (ret < 0) {
+				// a failing sensor stays readable, do not spin on it
+				usleep(READ_RETRY_DELAY_US);
+			}
+			continue;
+		}
+
+		slot.merged = 0;
+		while ((ret = resource_pms7003_read_nowait(slot.sensor, &slot.frame)) > 0)
+			queued |= _reader_push(&slot);
+		// a failing sensor stays readable, do not spin on it
+		if (ret < 0)
+			usleep(READ_RETRY_DELAY_US);
+	}
+
+	return queued;
+}
+
+static void *_reader_thread_func(void *data)
+{
+	const char token = 0;
+	unsigned int applied_period = PERIOD_UNSET;
+	bool passive = false;
+	uint64_t next_read_ms = 0;
+	uint64_t last_request_ms = 0;
+	int count = resource_pms7003_count();
+	bool queued;
+
+	INFO("----- PMS7003 reader thread started, sensors [%d] -----", count);
+
+	while (!__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE)) {
+		unsigned int period = __atomic_load_n(&passive_period_ms, __ATOMIC_ACQUIRE);
+
+		// the sensor keeps its mode across app restarts, set it explicitly once
+		if (period != applied_period) {
+			bool want_passive = (period != 0);
+			bool switched = (applied_period == PERIOD_UNSET || want_passive != passive);
+
+			if (switched) {
+				passive = _reader_set_passive(count, want_passive);
+				INFO("PMS7003 %s mode, period [%u] ms", passive ? "passive" : "active", period);
+			}
+			applied_period = period;
+			// the new period counts from the last request, the read is due at once only if it already elapsed
+			if (switched || last_request_ms == 0)
+				next_read_ms = _now_ms();
+			else
+				next_read_ms = last_request_ms + period;
+		}
+
+		if (passive) {
+			// one request per period, the period starts when the requests are sent
+			_reader_sleep_sensors(count, next_read_ms, period);
+			_reader_wait_until(next_read_ms, period);
+			if (__atomic_load_n(&passive_period_ms, __ATOMIC_ACQUIRE) != period)
+				continue;
+			if (__atomic_load_n(&reader_stop, __ATOMIC_ACQUIRE))
+				break;
+			last_request_ms = _now_ms();
+			next_read_ms = last_request_ms + period;
+			queued = _reader_request_frames(count);
+		} else {
+			queued = _reader_read_frames();
+		}
+
+		// wake up the main loop, the pipe handler drains the queue
+		if (queued)
+			ecore_pipe_write(wakeup_pipe, &token, sizeof(token));
+	}
+
+	INFO("----- PMS7003 reader thread stopped -----");
+	return NULL;
+}
+
+void resource_pms7003_reader_set_period(unsigned int period_ms)
+{
+	__atomic_store_n(&passive_period_ms, period_ms, __ATOMIC_RELEASE);
+	resource_pms7003_wakeup();
+}
+
+void resource_pms7003_reader_set_sleep(unsigned int warmup_ms)
+{
+	__atomic_store_n(&sleep_warmup_ms, warmup_ms, __ATOMIC_RELEASE);
+	resource_pms7003_wakeup();
+}
+
+void resource_pms7003_reader_set_drain(pms7003_drain_e mode)
+{
+	__atomic_store_n(&drain_mode, mode, __ATOMIC_RELAXED);
+}
+
+void resource_pms7003_reader_get_stats(pms7003_reader_stats_t *stats)
+{
+	*stats = reader_stats;
+}
+
+/*
+ * start the reader thread, frame_cb is called on the main loop for each decoded frame
+ * must be called from the main loop
+ */
+bool resource_pms7003_reader_start(pms7003_frame_cb frame_cb, void *user_data)
+{
+	if (reader_running) return true;
+
+	if (!resource_pms7003_init()) {
+		ERR("resource initialization failed");
+		return false;
+	}
+
+	g_frame_cb = frame_cb;
+	g_frame_cb_data = user_data;
+	frame_queue.head = frame_queue.tail = 0;
+	dropped_frames = 0;
+	memset(&reader_stats, 0, sizeof(reader_stats));
+	reader_stop = false;
+
+	wakeup_pipe = ecore_pipe_add(_wakeup_pipe_cb, NULL);
+	if (!wakeup_pipe) {
+		ERR("Failed to add wakeup pipe");
+		return false;
+	}
+
+	if (pthread_create(&reader_thread, NULL, _reader_thread_func, NULL) != 0) {
+		ERR("Failed to create reader thread");
+		ecore_pipe_del(wakeup_pipe);
+		wakeup_pipe = NULL;
+		return false;
+	}
+
+	reader_running = true;
+	return true;
+}
+
+/*
+ * stop and join the reader thread, must be called before resource_pms7003_fini()
+ */
+void resource_pms7003_reader_stop(void)
+{
+	if (!reader_running) return;
+
+	INFO("----- resource_pms7003_reader_stop -----");
+
+	__atomic_store_n(&reader_stop, true, __ATOMIC_RELEASE);
+	resource_pms7003_cancel();
+	pthread_join(reader_thread, NULL);
+	reader_running = false;
+
+	if (wakeup_pipe) {
+		ecore_pipe_del(wakeup_pipe);
+		wakeup_pipe = NULL;
+	}
+
+	g_frame_cb = NULL;
+	g_frame_cb_data = NULL;
+}
@@ -14,9 +14,21 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <peripheral_io.h>
+#include <time.h>
+#include <app_common.h>
 #include "resource/resource_pms7003_sensor.h"
+#include "resource/pms7003_parser.h"
+#include "resource/uart_transport.h"
+#include "resource/pms7003_simulator.h"
+#include "resource/pms7003_capture.h"
 #include "log.h"
 
 /*
@@ -39,292 +51,906 @@
  * If the concentration change is small the sensor would run at stable mode with the real interval of 2.3s.
  * And if the change is big the sensor would be changed to fast mode automatically with the interval of 200~800ms,
  * the higher of the concentration, the shorter of the interval.
+ *
+ * In passive mode the sensor sends one data frame for each read command (0xE2).
+ * Mode (0xE1) and sleep (0xE4) commands are answered by an 8 byte response frame,
+ * wake up is not answered.
  */
 
 //#define DEBUG
 
 #define MAX_TRY_COUNT	10
-#define UART_PORT		4	// ARTIK 530 : UART0
-#define MAX_FRAME_LEN	32
-
-int incoming_byte = 0;          // for incoming serial data
-char frame_buf[MAX_FRAME_LEN];  // for save pms7003 protocol data
-int byte_position = 0;          // next byte position in frame_buf
-int frame_len = MAX_FRAME_LEN;  // length of frame
-bool in_frame = false;          // to check start character
-unsigned int calc_checksum = 0; // to save calculated checksum value
+#define UART_PORTS_DEFAULT	"4"	// ARTIK 530 : UART0
+#define UART_BAUD_RATE	9600
+#define UART_PORTS_ENV	"PMS7003_UART_PORTS"	// peripheral-io UART ports, one sensor each, "4" by default
+#define UART_DEVICE_ENV	"PMS7003_UART_DEVICE"	// if set, tty paths used through the termios backend, one sensor each
+#define SIMULATOR_ENV	"PMS7003_SIMULATOR"		// if set, simulator options, the sensors are replaced by virtual PMS7003s
+#define SIMULATOR_COUNT_ENV	"PMS7003_SIMULATOR_COUNT"	// number of virtual PMS7003s, 1 by default
+#define REPLAY_ENV		"PMS7003_REPLAY"		// if set, capture files replayed instead of the sensors, one sensor each
+#define REPLAY_SPEED_ENV	"PMS7003_REPLAY_SPEED"	// replay time scale, 1.0 by default, 0 as fast as possible
+#define CAPTURE_ENV		"PMS7003_CAPTURE"		// if set, received bytes are recorded into this file, relative to the app data path
+#define SOURCE_SEPARATOR	","					// separator of the per-sensor lists above
+#define READ_POLL_MS	100	// wake up period of a blocking read to check cancellation
+#define WAIT_STEP_MS	20	// poll period of sensors without a pollable file descriptor
+#define RX_RING_SIZE	256	// UART receive ring, holds several frames
+#define READ_STATS_LOG_PERIOD	100	// log UART read statistics every N decoded frames
+#define COMMAND_TIMEOUT_MS	1500	// wait for a command response or a passive read frame
+#define FLUSH_MAX_READS	16		// bounded drain of stale input before a passive read
+
+typedef enum {
+	SOURCE_PORT = 0,	// peripheral-io UART port
+	SOURCE_DEVICE,		// tty device path
+	SOURCE_SIMULATOR,	// virtual PMS7003
+	SOURCE_REPLAY,		// capture file
+} _source_e;
 
-// DATA STRUCTURE FOR PMS7003 PROTOCOL
-static _pms7003_protocol_t pms7003_protocol;
+/*
+ * one PMS7003 : UART transport, frame parser and receive ring
+ * owned by the reader thread once initialized
+ */
+typedef struct {
+	int					id;
+	bool				initialized;
+	uart_transport_t	uart;
+	pms7003_parser_t	parser;			// PMS7003 frame parser of the UART byte stream
+	pms7003_simulator_t	simulator;
+	pms7003_capture_t	capture;
+
+	// UART receive ring : filled by bulk reads, consumed in chunks by the frame parser
+	uint8_t				rx_ring[RX_RING_SIZE];
+	unsigned int		rx_head;		// next write position
+	unsigned int		rx_tail;		// next read position
+	uint64_t			rx_arrival_ms;	// monotonic time the buffered bytes were read
+
+	// read statistics : number of UART read calls per decoded frame
+	unsigned long		read_calls;
+	unsigned long		decoded_frames;
+} _pms7003_sensor_t;
+
+static _pms7003_sensor_t sensors[PMS7003_SENSOR_MAX];
+static int sensor_count = 0;
 
 static bool initialized = false;
-static peripheral_uart_h g_uart_h;
+static bool read_canceled = false;	// set from another thread to abort a blocking read
+static int wakeup_fds[2] = { -1, -1 };	// pipe, interrupts resource_pms7003_wait() from another thread
+
+static _pms7003_sensor_t *_sensor(int id)
+{
+	if (id < 0 || id >= sensor_count || !sensors[id].initialized)
+		return NULL;
+	return &sensors[id];
+}
+
+/*
+ * create the UART transport of sensor s from one entry of the source list
+ */
+static bool _create_transport(_pms7003_sensor_t *s, _source_e source, const char *entry)
+{
+	switch (source) {
+	case SOURCE_REPLAY: {
+		const char *speed = getenv(REPLAY_SPEED_ENV);
+		return uart_transport_replay_create(&s->uart, entry, speed ? strtod(speed, NULL) : 1.0);
+	}
+	case SOURCE_SIMULATOR: {
+		pms7003_sim_config_t config;
+
+		if (!pms7003_simulator_parse_config(entry, &config))
+			return false;
+		// every virtual sensor sees its own noise
+		config.seed += s->id;
+		if (!pms7003_simulator_start(&s->simulator, &config))
+			return false;
+		return uart_transport_termios_create(&s->uart, s->simulator.slave_path);
+	}
+	case SOURCE_DEVICE:
+		return uart_transport_termios_create(&s->uart, entry);
+	case SOURCE_PORT:
+	default:
+		return uart_transport_peripheral_create(&s->uart, atoi(entry));
+	}
+}
 
-extern void set_sensor_value(_pms7003_protocol_t pms7003_protocol);
+/*
+ * start recording received bytes when PMS7003_CAPTURE is set
+ * sensor 0 records into the named file, sensor N into the named file with suffix .N
+ */
+static void _start_capture(_pms7003_sensor_t *s)
+{
+	const char *name = getenv(CAPTURE_ENV);
+	char path[256] = {0,};
+	char *data_path = NULL;
+	int len;
+
+	if (!name || name[0] == '\0')
+		return;
+
+	if (name[0] == '/') {
+		len = snprintf(path, sizeof(path), "%s", name);
+	} else {
+		data_path = app_get_data_path();
+		if (!data_path) {
+			ERR("app_data_path is NULL!!");
+			return;
+		}
+		len = snprintf(path, sizeof(path), "%s/%s", data_path, name);
+		free(data_path);
+	}
+	if (s->id > 0 && len > 0 && len < (int)sizeof(path))
+		snprintf(path + len, sizeof(path) - len, ".%d", s->id);
+
+	pms7003_capture_open(&s->capture, path);
+}
 
 /*
- * open UART port and set UART handle resource
+ * open UART port of one sensor and set UART handle resource
  * set BAUD rate, byte size, parity bit, stop bit, flow control
  * Appendix I：PMS7003 transport protocol-Active Mode
  * Default baud rate：9600bps Check bit：None Stop bit：1 bit
  */
-bool resource_pms7003_init(void)
+static bool _open_sensor(_pms7003_sensor_t *s, _source_e source, const char *entry)
 {
-	if (initialized) return true;
-
-	INFO("----- resource_pms7003_init -----");
-	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+	if (!_create_transport(s, source, entry)) {
+		ERR("sensor [%d] UART transport create Failed", s->id);
+		return false;
+	}
 
 	// Opens the UART slave device
-	ret = peripheral_uart_open(UART_PORT, &g_uart_h);
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("UART port [%d] open Failed, ret [%d]", UART_PORT, ret);
+	if (!s->uart.ops->open(&s->uart)) {
+		ERR("sensor [%d] UART [%s] open Failed", s->id, s->uart.ops->name);
+		pms7003_simulator_stop(&s->simulator);
 		return false;
 	}
-	// Sets baud rate of the UART slave device.
-	ret = peripheral_uart_set_baud_rate(g_uart_h, PERIPHERAL_UART_BAUD_RATE_9600);	// The number of signal in one second is 9600
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("uart_set_baud_rate set Failed, ret [%d]", ret);
+	// 9600bps, 8 data bits, no parity, one stop bit, no flow control
+	if (!s->uart.ops->configure(&s->uart, UART_BAUD_RATE)) {
+		ERR("sensor [%d] UART [%s] configure Failed", s->id, s->uart.ops->name);
+		s->uart.ops->close(&s->uart);
+		pms7003_simulator_stop(&s->simulator);
 		return false;
 	}
-	// Sets byte size of the UART slave device.
-	ret = peripheral_uart_set_byte_size(g_uart_h, PERIPHERAL_UART_BYTE_SIZE_8BIT);	// 8 data bits
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("byte_size set Failed, ret [%d]", ret);
-		return false;
+	INFO("sensor [%d] UART transport [%s] opened", s->id, s->uart.ops->name);
+
+	s->rx_head = s->rx_tail = 0;
+	pms7003_parser_init(&s->parser);
+	_start_capture(s);
+
+	s->initialized = true;
+	return true;
+}
+
+static void _close_sensor(_pms7003_sensor_t *s)
+{
+	if (!s->initialized)
+		return;
+
+	// Closes the UART slave device
+	s->uart.ops->close(&s->uart);
+	pms7003_simulator_stop(&s->simulator);
+	pms7003_capture_close(&s->capture);
+	s->initialized = false;
+	s->rx_head = s->rx_tail = 0;
+}
+
+/*
+ * select the UART transport backend and the list of sensors
+ * replay of capture files when PMS7003_REPLAY is set, virtual PMS7003s when PMS7003_SIMULATOR is set,
+ * termios when PMS7003_UART_DEVICE names ttys, peripheral-io ports of the board otherwise
+ */
+static const char *_select_source(_source_e *source)
+{
+	const char *device = getenv(UART_DEVICE_ENV);
+	const char *replay = getenv(REPLAY_ENV);
+	const char *ports = getenv(UART_PORTS_ENV);
+
+	if (replay && replay[0] != '\0') {
+		*source = SOURCE_REPLAY;
+		return replay;
 	}
-	// Sets parity bit of the UART slave device.
-	ret = peripheral_uart_set_parity(g_uart_h, PERIPHERAL_UART_PARITY_NONE);	// No parity is used
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("parity set Failed, ret [%d]", ret);
-		return false;
+	if (getenv(SIMULATOR_ENV)) {
+		*source = SOURCE_SIMULATOR;
+		return getenv(SIMULATOR_ENV);
 	}
-	// Sets stop bits of the UART slave device
-	ret = peripheral_uart_set_stop_bits (g_uart_h, PERIPHERAL_UART_STOP_BITS_1BIT);	// One stop bit
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("stop_bits set Failed, ret [%d]", ret);
-		return false;
+	if (device && device[0] != '\0') {
+		*source = SOURCE_DEVICE;
+		return device;
+	}
+
+	*source = SOURCE_PORT;
+	return (ports && ports[0] != '\0') ? ports : UART_PORTS_DEFAULT;
+}
+
+/*
+ * open every configured sensor, sensors are numbered in list order from 0
+ * succeeds when at least one sensor is opened, a sensor that failed stays closed
+ */
+bool resource_pms7003_init(void)
+{
+	_source_e source;
+	const char *list;
+	char *str = NULL;
+	char *token = NULL;
+	char *save = NULL;
+	int opened = 0;
+	int i;
+
+	__atomic_store_n(&read_canceled, false, __ATOMIC_RELEASE);
+
+	if (initialized) return true;
+
+	INFO("----- resource_pms7003_init -----");
+
+	list = _select_source(&source);
+	sensor_count = 0;
+
+	if (source == SOURCE_SIMULATOR) {
+		// one simulator spec for all virtual sensors
+		const char *count_spec = getenv(SIMULATOR_COUNT_ENV);
+		int count = count_spec ? atoi(count_spec) : 1;
+
+		if (count < 1)
+			count = 1;
+		if (count > PMS7003_SENSOR_MAX)
+			count = PMS7003_SENSOR_MAX;
+
+		for (i = 0; i < count; i++) {
+			memset(&sensors[i], 0, sizeof(_pms7003_sensor_t));
+			sensors[i].id = i;
+			if (_open_sensor(&sensors[i], source, list))
+				opened++;
+		}
+		sensor_count = count;
+	} else {
+		str = strdup(list);
+		if (!str)
+			return false;
+
+		for (token = strtok_r(str, SOURCE_SEPARATOR, &save); token; token = strtok_r(NULL, SOURCE_SEPARATOR, &save)) {
+			if (sensor_count == PMS7003_SENSOR_MAX) {
+				WARN("more than %d sensors, [%s] ignored", PMS7003_SENSOR_MAX, token);
+				continue;
+			}
+			i = sensor_count++;
+			memset(&sensors[i], 0, sizeof(_pms7003_sensor_t));
+			sensors[i].id = i;
+			if (_open_sensor(&sensors[i], source, token))
+				opened++;
+		}
+		free(str);
 	}
-	// Sets flow control of the UART slave device.
-	// No software flow control & No hardware flow control
-	ret = peripheral_uart_set_flow_control (g_uart_h, PERIPHERAL_UART_SOFTWARE_FLOW_CONTROL_NONE, PERIPHERAL_UART_HARDWARE_FLOW_CONTROL_NONE);
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("flow control set Failed, ret [%d]", ret);
+
+	if (opened == 0) {
+		ERR("no sensor opened");
+		sensor_count = 0;
 		return false;
 	}
+	INFO("sensors opened [%d / %d]", opened, sensor_count);
+
+	if (pipe2(wakeup_fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+		// still works, waits on sensors without a file descriptor are bounded anyway
+		ERR("wake up pipe create failed, errno [%d]", errno);
+		wakeup_fds[0] = wakeup_fds[1] = -1;
+	}
 
 	initialized = true;
 	return true;
 }
 
+// number of configured sensors, valid ids are 0 ~ count - 1
+int resource_pms7003_count(void)
+{
+	return sensor_count;
+}
+
+// true if sensor id was opened by resource_pms7003_init()
+bool resource_pms7003_is_open(int id)
+{
+	return _sensor(id) != NULL;
+}
+
 /*
  * To write data to a slave device
  */
-bool resource_write_data(uint8_t *data, uint32_t length)
+bool resource_write_data(int id, uint8_t *data, uint32_t length)
 {
-	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+	_pms7003_sensor_t *s = _sensor(id);
+	uint32_t written = 0;
 
-	// write length byte data to UART
-	ret = peripheral_uart_write(g_uart_h, data, length);
-	if (ret != PERIPHERAL_ERROR_NONE) {
-		ERR("UART write failed, ret [%d]", ret);
+	if (!s)
 		return false;
+
+	// write length byte data to UART
+	while (written < length) {
+		int ret = s->uart.ops->write(&s->uart, data + written, length - written);
+		if (ret < 0) {
+			ERR("sensor [%d] UART write failed, ret [%d]", id, ret);
+			return false;
+		}
+		written += ret;
 	}
 
 	return true;
 }
 
+static uint64_t _now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * read up to length bytes, blocks until at least one byte is available or until deadline_ms
+ * (monotonic milliseconds, 0 waits forever)
+ */
+static bool _read_available(_pms7003_sensor_t *s, uint8_t *data, uint32_t length, uint32_t *read_len, uint64_t deadline_ms)
+{
+	int ret = 0;
+
+	while (1) {
+		int timeout_ms = READ_POLL_MS;
+
+		if (__atomic_load_n(&read_canceled, __ATOMIC_ACQUIRE)) {
+			INFO("UART read canceled");
+			return false;
+		}
+
+		if (deadline_ms) {
+			uint64_t now = _now_ms();
+			if (now >= deadline_ms)
+				return false;
+			if (deadline_ms - now < (uint64_t)timeout_ms)
+				timeout_ms = deadline_ms - now;
+		}
+
+		// wait for data, wake up periodically to check cancellation
+		ret = s->uart.ops->poll(&s->uart, timeout_ms);
+		if (ret < 0) {
+			ERR("sensor [%d] UART poll failed, ret [%d]", s->id, ret);
+			return false;
+		}
+		if (ret == 0)
+			continue;
+
+		s->read_calls++;
+		ret = s->uart.ops->read(&s->uart, data, length);
+		if (ret > 0) {
+			// number of bytes read
+			*read_len = ret;
+			if (s->capture.fp)
+				pms7003_capture_write(&s->capture, data, ret);
+			return true;
+		}
+		if (ret < 0) {
+			ERR("sensor [%d] UART read failed, ret [%d]", s->id, ret);
+			return false;
+		}
+	}
+}
+
+/*
+ * To read up to length bytes from a slave device, blocks until at least one byte is available
+ * the number of bytes actually read is stored into *read_len
+ */
+bool resource_read_available(int id, uint8_t *data, uint32_t length, uint32_t *read_len)
+{
+	_pms7003_sensor_t *s = _sensor(id);
+
+	if (!s)
+		return false;
+	return _read_available(s, data, length, read_len, 0);
+}
+
 /*
  * To read data from a slave device
  */
-bool resource_read_data(uint8_t *data, uint32_t length, bool blocking_mode)
+bool resource_read_data(int id, uint8_t *data, uint32_t length, bool blocking_mode)
 {
+	_pms7003_sensor_t *s = _sensor(id);
 	int try_again = 0;
-	peripheral_error_e ret = PERIPHERAL_ERROR_NONE;
+	uint32_t received = 0;
+	uint32_t read_len = 0;
 
-	if (g_uart_h == NULL)
+	if (!s)
 		return false;
 
-	while (1) {
-		// read length byte from UART
-		ret = peripheral_uart_read(g_uart_h, data, length);
-		if (ret == PERIPHERAL_ERROR_NONE)
-			return true;
+	while (received < length) {
+		// if blocking mode, wait until data is received
+		if (blocking_mode == true) {
+			if (!_read_available(s, data + received, length - received, &read_len, 0))
+				return false;
+			received += read_len;
+			continue;
+		}
 
-		// if data is not ready, try again
-		if (ret == PERIPHERAL_ERROR_TRY_AGAIN) {
-			// if blocking mode, read again
-			if (blocking_mode == true) {
-				usleep(100 * 1000);
-				INFO(".");
-				continue;
-			} else {
-				// if non-blocking mode, retry MAX_TRY_COUNT
-				if (try_again >= MAX_TRY_COUNT) {
-					ERR("No data to receive");
-					return false;
-				} else {
-					try_again++;
-				}
-			}
-		} else {
-			// if return value is not (PERIPHERAL_ERROR_NONE or PERIPHERAL_ERROR_TRY_AGAIN)
-			// return with false
-			ERR("UART read failed, , ret [%d]", ret);
+		// if non-blocking mode, retry MAX_TRY_COUNT
+		s->read_calls++;
+		int ret = s->uart.ops->read(&s->uart, data + received, length - received);
+		if (ret < 0) {
+			ERR("sensor [%d] UART read failed, ret [%d]", id, ret);
 			return false;
 		}
+		if (ret == 0) {
+			if (try_again >= MAX_TRY_COUNT) {
+				ERR("No data to receive");
+				return false;
+			}
+			try_again++;
+			continue;
+		}
+		if (s->capture.fp)
+			pms7003_capture_write(&s->capture, data + received, ret);
+		received += ret;
 	}
 
 	return true;
 }
 
 /*
- * close UART handle and clear UART resources
+ * refill the empty receive ring with one bulk read of whatever is available
+ */
+static bool _rx_ring_fill(_pms7003_sensor_t *s, uint64_t deadline_ms)
+{
+	uint32_t read_len = 0;
+
+	// ring is empty : restart at the beginning so the parser gets one contiguous chunk
+	s->rx_head = s->rx_tail = 0;
+	if (!_read_available(s, s->rx_ring, RX_RING_SIZE, &read_len, deadline_ms))
+		return false;
+	s->rx_head = read_len;
+	s->rx_arrival_ms = _now_ms();
+
+	return true;
+}
+
+/*
+ * UART read calls and decoded frames of sensor id since init, reads / frames is the cost of one frame
+ */
+void resource_pms7003_get_read_stats(int id, unsigned long *read_calls, unsigned long *frames)
+{
+	_pms7003_sensor_t *s = _sensor(id);
+
+	*read_calls = s ? s->read_calls : 0;
+	*frames = s ? s->decoded_frames : 0;
+}
+
+/*
+ * decoded frames and checksum errors of sensor id since init, can be called from any thread
+ */
+void resource_pms7003_get_frame_stats(int id, unsigned long *frames, unsigned long *checksum_errors)
+{
+	_pms7003_sensor_t *s = _sensor(id);
+
+	*frames = s ? __atomic_load_n(&s->decoded_frames, __ATOMIC_RELAXED) : 0;
+	*checksum_errors = s ? __atomic_load_n(&s->parser.checksum_errors, __ATOMIC_RELAXED) : 0;
+}
+
+/*
+ * interrupt resource_pms7003_wait() or resource_pms7003_sleep() running on the reader thread,
+ * e.g. after a configuration change, can be called from any thread
+ */
+void resource_pms7003_wakeup(void)
+{
+	const uint8_t token = 0;
+
+	if (wakeup_fds[1] >= 0 && write(wakeup_fds[1], &token, sizeof(token)) < 0 && errno != EAGAIN)
+		ERR("wake up write failed, errno [%d]", errno);
+}
+
+/*
+ * abort a blocking resource_pms7003_read(), resource_pms7003_wait() or resource_pms7003_sleep()
+ * running on the reader thread, a pending wait or sleep returns at once, a read within one retry period
+ */
+void resource_pms7003_cancel(void)
+{
+	__atomic_store_n(&read_canceled, true, __ATOMIC_RELEASE);
+	resource_pms7003_wakeup();
+}
+
+/*
+ * close UART handles and clear UART resources of every sensor
  */
 void resource_pms7003_fini(void)
 {
+	int i;
+
 	INFO("----- resource_pms7003_fini -----");
 	if(initialized) {
-		// Closes the UART slave device
-		peripheral_uart_close(g_uart_h);
+		for (i = 0; i < sensor_count; i++)
+			_close_sensor(&sensors[i]);
+		sensor_count = 0;
+		close(wakeup_fds[0]);
+		close(wakeup_fds[1]);
+		wakeup_fds[0] = wakeup_fds[1] = -1;
 		initialized = false;
-		g_uart_h = NULL;
 	}
 }
 
 /*
- * read sensor data from PMS7003 and format
+ * parse the buffered bytes up to the first complete frame, returns the number of frames (0 or 1)
  */
-bool resource_pms7003_read(void)
+static size_t _parse_ring(_pms7003_sensor_t *s, _pms7003_protocol_t *frame)
 {
-	uint8_t data;
-	bool packet_received = false;
-	calc_checksum = 0;
+	pms7003_parser_t *parser = &s->parser;
+	unsigned long checksum_errors = parser->checksum_errors;
+	size_t consumed = 0;
+	size_t count = 0;
+
+	count = pms7003_parser_feed(parser, &s->rx_ring[s->rx_tail], s->rx_head - s->rx_tail, frame, 1, &consumed);
+	s->rx_tail += consumed;
+
+	if (parser->checksum_errors != checksum_errors)
+		ERR("sensor [%d] Checksum error, dropped [%lu] frame candidates", s->id, parser->checksum_errors - checksum_errors);
 
-	// clear frame buffer
-	memset(frame_buf, 0, MAX_FRAME_LEN);
+	if (count == 0)
+		return 0;
 
-	// clear pms7003_protocol structure
-	memset(&pms7003_protocol, 0, sizeof(_pms7003_protocol_t));
+	// the ring is refilled only when empty, the last byte of the frame came with the last read
+	frame->arrival_ms = s->rx_arrival_ms;
+	if (frame->frame_len == PMS7003_RESPONSE_FRAME_LEN)
+		return count;
 
-	// set Frame length = 2x13 + 2 (data+check bytes)
-	pms7003_protocol.frame_len = MAX_FRAME_LEN - sizeof(pms7003_protocol.checksum);
+	s->decoded_frames++;
+	if ((s->decoded_frames % READ_STATS_LOG_PERIOD) == 0)
+		INFO("sensor [%d] UART read calls [%lu] device reads [%lu] / decoded frames [%lu], checksum errors [%lu], length errors [%lu], discarded bytes [%lu]",
+				s->id, s->read_calls, s->uart.device_reads, s->decoded_frames, parser->checksum_errors, parser->length_errors, parser->discarded_bytes);
+
+	return count;
+}
+
+/*
+ * next frame of the byte stream, data frame or command response
+ * blocks until deadline_ms (monotonic milliseconds, 0 waits forever)
+ */
+static bool _next_frame(_pms7003_sensor_t *s, _pms7003_protocol_t *frame, uint64_t deadline_ms)
+{
+	while (1) {
+		// the parser can hold a complete frame behind the previous one
+		if (_parse_ring(s, frame) > 0)
+			return true;
 
-	if (!initialized) {
-		// open UART port and set UART handle resource
-		// set BAUD rate, byte size, parity bit, stop bit, flow control
-		if (!resource_pms7003_init()) {
-			ERR("resource initialization failed");
+		// refill the receive ring, block until data is received
+		if (s->rx_head == s->rx_tail && !_rx_ring_fill(s, deadline_ms))
 			return false;
+	}
+}
+
+/*
+ * drop buffered and pending input, so the next data frame answers the next read command
+ */
+static void _flush_input(_pms7003_sensor_t *s)
+{
+	uint32_t read_len = 0;
+	int i;
+
+	s->rx_head = s->rx_tail = 0;
+	pms7003_parser_reset(&s->parser);
+
+	for (i = 0; i < FLUSH_MAX_READS && s->uart.ops->poll(&s->uart, 0) > 0; i++) {
+		if (!_read_available(s, s->rx_ring, RX_RING_SIZE, &read_len, 0))
+			break;
+		s->parser.discarded_bytes += read_len;
+	}
+}
+
+/*
+ * send a command, wait for its data frame (read) or response frame (mode, sleep)
+ * frames of other kinds received meanwhile are skipped
+ */
+static bool _send_command(int id, uint8_t cmd, uint16_t data, bool answered, _pms7003_protocol_t *reply)
+{
+	_pms7003_sensor_t *s = _sensor(id);
+	uint8_t buf[PMS7003_COMMAND_SIZE];
+	_pms7003_protocol_t frame;
+	uint64_t deadline_ms;
+
+	if (!s) {
+		ERR("sensor [%d] is not initialized", id);
+		return false;
+	}
+
+	if (cmd == PMS7003_CMD_READ)
+		_flush_input(s);
+
+	pms7003_encode_command(cmd, data, buf);
+	if (!resource_write_data(id, buf, sizeof(buf))) {
+		ERR("sensor [%d] command [0x%02X] write failed", id, cmd);
+		return false;
+	}
+	if (!answered)
+		return true;
+
+	deadline_ms = _now_ms() + COMMAND_TIMEOUT_MS;
+	while (_next_frame(s, &frame, deadline_ms)) {
+		bool response = (frame.frame_len == PMS7003_RESPONSE_FRAME_LEN);
+
+		if ((cmd == PMS7003_CMD_READ && !response) || (response && frame.response_cmd == cmd)) {
+			if (reply)
+				*reply = frame;
+			return true;
 		}
 	}
 
-	while (!packet_received) {
-		 // read data from a slave device, block until data is received
-		if (resource_read_data(&data, 1, true) == false) {
-			ERR("resource_read_data failed");
+	WARN("sensor [%d] no answer to command [0x%02X]", id, cmd);
+	return false;
+}
+
+/*
+ * switch the sensor between passive (frames on request) and active (streaming) mode
+ * called from the reader thread only
+ */
+bool resource_pms7003_set_passive(int id, bool passive)
+{
+	return _send_command(id, PMS7003_CMD_MODE, passive ? PMS7003_MODE_PASSIVE : PMS7003_MODE_ACTIVE, true, NULL);
+}
+
+/*
+ * passive mode : request one frame and wait for it, the decoded frame is stored into *frame
+ * called from the reader thread only
+ */
+bool resource_pms7003_request_read(int id, _pms7003_protocol_t *frame)
+{
+	return _send_command(id, PMS7003_CMD_READ, 0, true, frame);
+}
+
+/*
+ * put the sensor to sleep (laser and fan off) or wake it up, it takes about 30 seconds
+ * after wake up before the readings are stable
+ * called from the reader thread only
+ */
+bool resource_pms7003_set_sleep(int id, bool sleep)
+{
+	if (!sleep)
+		return _send_command(id, PMS7003_CMD_SLEEP, PMS7003_WAKEUP, false, NULL);
+	return _send_command(id, PMS7003_CMD_SLEEP, PMS7003_SLEEP, true, NULL);
+}
+
+/*
+ * read sensor data from PMS7003 and format
+ * blocks until one frame is received, the decoded frame is stored into *frame
+ * called from the reader thread only, never from the main loop
+ */
+bool resource_pms7003_read(int id, _pms7003_protocol_t *frame)
+{
+	_pms7003_sensor_t *s = _sensor(id);
+
+	if (!s) {
+		ERR("sensor [%d] is not initialized", id);
+		return false;
+	}
+
+	do {
+		if (!_next_frame(s, frame, 0)) {
+			ERR("sensor [%d] UART receive failed", id);
 			return false;
 		}
+		// a late command response is not sensor data
+	} while (frame->frame_len == PMS7003_RESPONSE_FRAME_LEN);
 
-		#ifdef DEBUG
-		//INFO("READ: [0x%02X]", incoming_byte);
-		#endif
-
-		if (!in_frame) {
-			if (data == 0x42 && byte_position == 0) {
-				#ifdef DEBUG
-				INFO("READ: [0x%02X] ST1", data);
-				#endif
-				frame_buf[byte_position] = data;            // add start character 1 into buffer
-				pms7003_protocol.frame_header[0] = data;
-				calc_checksum = data;                       // add data to Checksum
-				byte_position++;                            // set to next position
-			}
-			else if (data == 0x4D && byte_position == 1) {
-				#ifdef DEBUG
-				INFO("READ: [0x%02X] ST2", data);
-				#endif
-				frame_buf[byte_position] = data;            // add start character 2 into buffer
-				pms7003_protocol.frame_header[1] = data;
-				calc_checksum += data;                      // add data to Checksum
-
-				// we have valid frame header
-				in_frame = true;                                     // received start char 1[0x42] and char 2[0x4d]
-				byte_position++;                                     // set to next position
-			}
-			else {
-				// data is not in synced, ignore data
-				#ifdef DEBUG
-				INFO("Frame syncing... [0x%02X]", data);
-				#endif
-			}
-		}
-		else {
-			#ifdef DEBUG
-			INFO("READ: [0x%02X]", data);
-			#endif
-			// save data into frame buffer
-			frame_buf[byte_position] = data;
-			calc_checksum += data;
-			byte_position++;
-
-			unsigned int val = (frame_buf[byte_position - 1] & 0xff) + (frame_buf[byte_position - 2] << 8);
-			switch (byte_position) {
-			case 4:
-				pms7003_protocol.frame_len = val;
-				frame_len = val + byte_position;
-				#ifdef DEBUG
-				INFO("frame_len: [%d]", frame_len);
-				#endif
-				break;
-			case 6:
-				pms7003_protocol.standard_particle.PM1_0 = val;
-				break;
-			case 8:
-				pms7003_protocol.standard_particle.PM2_5 = val;
-				break;
-			case 10:
-				pms7003_protocol.standard_particle.PM10 = val;
-				break;
-			case 12:
-				pms7003_protocol.atmospheric_env.PM1_0 = val;
-				break;
-			case 14:
-				pms7003_protocol.atmospheric_env.PM2_5 = val;
-				break;
-			case 16:
-				pms7003_protocol.atmospheric_env.PM10 = val;
-				break;
-			case 32:
-				pms7003_protocol.checksum = val;
-				calc_checksum -= ((val>>8) + (val&0xFF));
-				break;
-			default:
-				break;
-			}
+	return true;
+}
+
+// drain the wake up pipe, returns true if a wake up was pending
+static bool _drain_wakeup(void)
+{
+	uint8_t buf[16];
+	bool woken = false;
 
-			// check if all data is received
-			if (byte_position >= frame_len) {
-				#ifdef DEBUG
-				INFO("READ: byte_position[%d] : frame_len[%d]", byte_position, frame_len);
-				#endif
-				packet_received = true;
-				byte_position = 0;
-				in_frame = false;
+	while (wakeup_fds[0] >= 0 && read(wakeup_fds[0], buf, sizeof(buf)) > 0)
+		woken = true;
+	return woken;
+}
+
+/*
+ * wait until at least one sensor has received data, for up to timeout_ms (-1 : no limit)
+ * bit N of *ready is set when sensor N can be read without blocking
+ * returns the number of ready sensors, 0 on timeout or resource_pms7003_wakeup(),
+ * negative on error or cancellation
+ * the thread sleeps in poll() until bytes arrive, only backends without a file descriptor
+ * (peripheral-io) are checked every WAIT_STEP_MS : on the board the thread still wakes
+ * 3000 times a minute, the HAL read does not block
+ * called from the reader thread only
+ */
+int resource_pms7003_wait(uint32_t *ready, int timeout_ms)
+{
+	struct pollfd pfds[PMS7003_SENSOR_MAX + 1];
+	int ids[PMS7003_SENSOR_MAX];
+	uint64_t deadline_ms = (timeout_ms < 0) ? 0 : _now_ms() + timeout_ms;
+	int n_fds, count, i, ret;
+	bool unpollable;
+
+	*ready = 0;
+	if (!initialized)
+		return -1;
+
+	while (1) {
+		if (__atomic_load_n(&read_canceled, __ATOMIC_ACQUIRE))
+			return -1;
+
+		// buffered bytes and backends without a file descriptor are checked directly
+		n_fds = count = 0;
+		unpollable = false;
+		for (i = 0; i < sensor_count; i++) {
+			_pms7003_sensor_t *s = &sensors[i];
+
+			if (!s->initialized)
+				continue;
+			if (s->rx_head != s->rx_tail || s->uart.pending_len > 0) {
+				*ready |= 1u << i;
+				count++;
+			} else if (s->uart.fd < 0) {
+				unpollable = true;
+				if (s->uart.ops->poll(&s->uart, 0) > 0) {
+					*ready |= 1u << i;
+					count++;
+				}
+			} else {
+				pfds[n_fds].fd = s->uart.fd;
+				pfds[n_fds].events = POLLIN;
+				pfds[n_fds].revents = 0;
+				ids[n_fds++] = i;
 			}
 		}
+		// the wake up pipe comes last
+		pfds[n_fds].fd = wakeup_fds[0];
+		pfds[n_fds].events = POLLIN;
+		pfds[n_fds].revents = 0;
+
+		int wait_ms = -1;
+		if (count > 0) {
+			wait_ms = 0;
+		} else if (deadline_ms) {
+			uint64_t now = _now_ms();
+			wait_ms = (now >= deadline_ms) ? 0 : (int)(deadline_ms - now);
+		}
+		// without a wake up pipe the cancellation is checked every WAIT_STEP_MS as well
+		if ((unpollable || wakeup_fds[0] < 0) && (wait_ms < 0 || wait_ms > WAIT_STEP_MS))
+			wait_ms = WAIT_STEP_MS;
+
+		ret = poll(pfds, n_fds + (wakeup_fds[0] >= 0 ? 1 : 0), wait_ms);
+		if (ret < 0 && errno != EINTR) {
+			ERR("UART poll failed, errno [%d]", errno);
+			return -1;
+		}
+		for (i = 0; ret > 0 && i < n_fds; i++) {
+			if (pfds[i].revents == 0)
+				continue;
+			// error or hang-up : report it ready, the read reports the error
+			*ready |= 1u << ids[i];
+			count++;
+		}
+
+		if (count > 0)
+			return count;
+		if (ret > 0 && pfds[n_fds].revents && _drain_wakeup())
+			return 0;
+		if (deadline_ms && _now_ms() >= deadline_ms)
+			return 0;
 	}
+}
+
+/*
+ * sleep up to timeout_ms without reading the sensors
+ * returns true if woken early by resource_pms7003_wakeup() or resource_pms7003_cancel()
+ * called from the reader thread only
+ */
+bool resource_pms7003_sleep(int timeout_ms)
+{
+	struct pollfd pfd = { .fd = wakeup_fds[0], .events = POLLIN };
 
-	// check received checksum and calculated checksum is same or not
-	// Checksum : Check code = START_CHAR1 + START_CHAR2 + data1 + …….. + data13
-	if (calc_checksum == pms7003_protocol.checksum) {
-		// save sensor data and return true
-		set_sensor_value(pms7003_protocol);
+	if (__atomic_load_n(&read_canceled, __ATOMIC_ACQUIRE))
 		return true;
-	} else {
-		// return false
-		ERR("Checksum error, calc_checksum[0x%X] != [0x%X] pms7003_protocol.checksum", calc_checksum, pms7003_protocol.checksum);
+	if (wakeup_fds[0] < 0) {
+		usleep(timeout_ms * 1000);
 		return false;
 	}
+
+	if (poll(&pfd, 1, timeout_ms) > 0 && _drain_wakeup())
+		return true;
+	return __atomic_load_n(&read_canceled, __ATOMIC_ACQUIRE);
 }
 
+/*
+ * next data frame out of what sensor id already received, never waits
+ * returns 1 if a frame was decoded, 0 if more bytes are needed, negative on error
+ * called from the reader thread only
+ */
+int resource_pms7003_read_nowait(int id, _pms7003_protocol_t *frame)
+{
+	_pms7003_sensor_t *s = _sensor(id);
+
+	if (!s)
+		return -1;
+
+	while (1) {
+		// a late command response is not sensor data
+		if (_parse_ring(s, frame) > 0) {
+			if (frame->frame_len != PMS7003_RESPONSE_FRAME_LEN)
+				return 1;
+			continue;
+		}
+
+		if (s->rx_head == s->rx_tail) {
+			int ret = s->uart.ops->poll(&s->uart, 0);
+			if (ret < 0)
+				return -1;
+			if (ret == 0)
+				return 0;
+			if (!_rx_ring_fill(s, 0))
+				return -1;
+		}
+	}
+}
+
+// running sums of the concentrations and particle counts of drained frames
+typedef struct {
+	uint32_t	standard[3];
+	uint32_t	atmospheric[3];
+	uint32_t	count[6];
+} _frame_sum_t;
+
+static void _frame_sum_add(_frame_sum_t *sum, const _pms7003_protocol_t *frame)
+{
+	sum->standard[0] += frame->standard_particle.PM1_0;
+	sum->standard[1] += frame->standard_particle.PM2_5;
+	sum->standard[2] += frame->standard_particle.PM10;
+	sum->atmospheric[0] += frame->atmospheric_env.PM1_0;
+	sum->atmospheric[1] += frame->atmospheric_env.PM2_5;
+	sum->atmospheric[2] += frame->atmospheric_env.PM10;
+	sum->count[0] += frame->particle_count.PC0_3;
+	sum->count[1] += frame->particle_count.PC0_5;
+	sum->count[2] += frame->particle_count.PC1_0;
+	sum->count[3] += frame->particle_count.PC2_5;
+	sum->count[4] += frame->particle_count.PC5_0;
+	sum->count[5] += frame->particle_count.PC10;
+}
+
+#define _MEAN(sum, n)	(uint16_t)(((sum) + (n) / 2) / (n))
+
+static void _frame_sum_mean(const _frame_sum_t *sum, unsigned int n, _pms7003_protocol_t *frame)
+{
+	frame->standard_particle.PM1_0 = _MEAN(sum->standard[0], n);
+	frame->standard_particle.PM2_5 = _MEAN(sum->standard[1], n);
+	frame->standard_particle.PM10 = _MEAN(sum->standard[2], n);
+	frame->atmospheric_env.PM1_0 = _MEAN(sum->atmospheric[0], n);
+	frame->atmospheric_env.PM2_5 = _MEAN(sum->atmospheric[1], n);
+	frame->atmospheric_env.PM10 = _MEAN(sum->atmospheric[2], n);
+	frame->particle_count.PC0_3 = _MEAN(sum->count[0], n);
+	frame->particle_count.PC0_5 = _MEAN(sum->count[1], n);
+	frame->particle_count.PC1_0 = _MEAN(sum->count[2], n);
+	frame->particle_count.PC2_5 = _MEAN(sum->count[3], n);
+	frame->particle_count.PC5_0 = _MEAN(sum->count[4], n);
+	frame->particle_count.PC10 = _MEAN(sum->count[5], n);
+}
+
+/*
+ * latest-wins read : decode every frame sensor id already received, never waits, and keep
+ * the newest one. With average set the concentrations and particle counts are the mean of
+ * all drained frames.
+ * *drained is set to the number of data frames consumed, arrival_ms of the returned frame is
+ * the one of the newest frame.
+ * returns 1 if a frame was decoded, 0 if no complete frame was received, negative on error
+ * before any frame, an error after frames is reported by the next call
+ * called from the reader thread only
+ */
+int resource_pms7003_read_latest(int id, _pms7003_protocol_t *frame, bool average, unsigned int *drained)
+{
+	_frame_sum_t sum;
+	_pms7003_protocol_t next;
+	unsigned int frames = 0;
+	int ret;
+
+	memset(&sum, 0, sizeof(sum));
+	while ((ret = resource_pms7003_read_nowait(id, &next)) > 0) {
+		*frame = next;
+		_frame_sum_add(&sum, frame);
+		frames++;
+	}
+
+	if (average && frames > 1)
+		_frame_sum_mean(&sum, frames, frame);
+	*drained = frames;
+
+	if (frames > 0)
+		return 1;
+	return ret;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include "resource/uart_transport.h"
+#include "log.h"
+
+#ifndef PMS7003_NO_PERIPHERAL_IO
+
+#include <peripheral_io.h>
+
+#define POLL_STEP_MS	10	// peripheral-io has no pollable fd, poll by reading every POLL_STEP_MS
+
+/*
+ * Tizen peripheral-io UART backend
+ */
+
+static bool _peripheral_open(uart_transport_t *transport)
+{
+	peripheral_uart_h uart_h = NULL;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	// Opens the UART slave device
+	ret = peripheral_uart_open(transport->port, &uart_h);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		ERR("UART port [%d] open Failed, ret [%d]", transport->port, ret);
+		return false;
+	}
+
+	transport->handle = uart_h;
+	transport->pending_len = 0;
+	return true;
+}
+
+static bool _peripheral_configure(uart_transport_t *transport, unsigned int baud_rate)
+{
+	peripheral_uart_h uart_h = transport->handle;
+	int ret = PERIPHERAL_ERROR_NONE;
+
+	if (baud_rate != 9600) {
+		ERR("unsupported baud rate [%u]", baud_rate);
+		return false;
+	}
+
+	// Sets baud rate of the UART slave device.
+	ret = peripheral_uart_set_baud_rate(uart_h, PERIPHERAL_UART_BAUD_RATE_9600);	// The number of signal in one second is 9600
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		ERR("uart_set_baud_rate set Failed, ret [%d]", ret);
+		return false;
+	}
+	// Sets byte size of the UART slave device.
+	ret = peripheral_uart_set_byte_size(uart_h, PERIPHERAL_UART_BYTE_SIZE_8BIT);	// 8 data bits
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		ERR("byte_size set Failed, ret [%d]", ret);
+		return false;
+	}
+	// Sets parity bit of the UART slave device.
+	ret = peripheral_uart_set_parity(uart_h, PERIPHERAL_UART_PARITY_NONE);	// No parity is used
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		ERR("parity set Failed, ret [%d]", ret);
+		return false;
+	}
+	// Sets stop bits of the UART slave device
+	ret = peripheral_uart_set_stop_bits (uart_h, PERIPHERAL_UART_STOP_BITS_1BIT);	// One stop bit
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		ERR("stop_bits set Failed, ret [%d]", ret);
+		return false;
+	}
+	// Sets flow control of the UART slave device.
+	// No software flow control & No hardware flow control
+	ret = peripheral_uart_set_flow_control (uart_h, PERIPHERAL_UART_SOFTWARE_FLOW_CONTROL_NONE, PERIPHERAL_UART_HARDWARE_FLOW_CONTROL_NONE);
+	if (ret != PERIPHERAL_ERROR_NONE) {
+		ERR("flow control set Failed, ret [%d]", ret);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * peripheral_uart_read() fails a request it cannot fill completely and the bytes it got are lost,
+ * so the device is read one byte per call until it has no more
+ */
+static int _peripheral_read_device(uart_transport_t *transport, uint8_t *data, uint32_t length)
+{
+	uint32_t len = 0;
+	int ret;
+
+	while (len < length) {
+		ret = peripheral_uart_read(transport->handle, data + len, 1);
+		transport->device_reads++;
+		// number of bytes read, or 0 on success on peripheral-io versions that do not count
+		if (ret >= 0) {
+			len++;
+			continue;
+		}
+		if (ret == PERIPHERAL_ERROR_TRY_AGAIN)
+			break;
+
+		ERR("UART read failed, ret [%d]", ret);
+		// bytes already read are delivered, the error comes back on the next read
+		return (len > 0) ? (int)len : -1;
+	}
+
+	return len;
+}
+
+static int _peripheral_read(uart_transport_t *transport, uint8_t *data, uint32_t length)
+{
+	// serve bytes taken by poll first
+	if (transport->pending_len > 0) {
+		uint32_t len = (length < transport->pending_len) ? length : transport->pending_len;
+
+		memcpy(data, transport->pending, len);
+		transport->pending_len -= len;
+		memmove(transport->pending, transport->pending + len, transport->pending_len);
+		return len;
+	}
+
+	return _peripheral_read_device(transport, data, length);
+}
+
+static int _peripheral_write(uart_transport_t *transport, const uint8_t *data, uint32_t length)
+{
+	int ret = peripheral_uart_write(transport->handle, (uint8_t *)data, length);
+
+	if (ret < 0) {
+		ERR("UART write failed, ret [%d]", ret);
+		return -1;
+	}
+
+	return length;
+}
+
+static int _peripheral_poll(uart_transport_t *transport, int timeout_ms)
+{
+	int waited_ms = 0;
+
+	while (transport->pending_len == 0) {
+		int ret = _peripheral_read_device(transport, transport->pending, UART_TRANSPORT_PENDING_MAX);
+		if (ret < 0)
+			return -1;
+		if (ret > 0) {
+			transport->pending_len = ret;
+			break;
+		}
+		if (waited_ms >= timeout_ms)
+			return 0;
+
+		usleep(POLL_STEP_MS * 1000);
+		waited_ms += POLL_STEP_MS;
+	}
+
+	return 1;
+}
+
+static void _peripheral_close(uart_transport_t *transport)
+{
+	if (transport->handle) {
+		// Closes the UART slave device
+		peripheral_uart_close(transport->handle);
+		transport->handle = NULL;
+	}
+	transport->pending_len = 0;
+}
+
+static const uart_transport_ops_t peripheral_ops = {
+	.name = "peripheral-io",
+	.open = _peripheral_open,
+	.configure = _peripheral_configure,
+	.read = _peripheral_read,
+	.write = _peripheral_write,
+	.poll = _peripheral_poll,
+	.close = _peripheral_close,
+};
+
+bool uart_transport_peripheral_create(uart_transport_t *transport, int port)
+{
+	memset(transport, 0, sizeof(uart_transport_t));
+	transport->ops = &peripheral_ops;
+	transport->port = port;
+	transport->fd = -1;
+
+	return true;
+}
+
+#else /* PMS7003_NO_PERIPHERAL_IO */
+
+bool uart_transport_peripheral_create(uart_transport_t *transport, int port)
+{
+	ERR("peripheral-io backend is not built in");
+	return false;
+}
+
+#endif /* PMS7003_NO_PERIPHERAL_IO */
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "resource/uart_transport.h"
+#include "resource/pms7003_capture.h"
+#include "log.h"
+
+/*
+ * Replay UART backend
+ * plays back a capture file chunk by chunk, at the recorded speed scaled by transport->speed,
+ * or as fast as the reader drains it when speed is 0.
+ * At the end of the capture the line goes silent.
+ */
+
+typedef struct {
+	pms7003_capture_reader_t	reader;
+	uint8_t		chunk[PMS7003_CAPTURE_CHUNK_MAX];
+	size_t		chunk_len;
+	size_t		chunk_pos;
+	uint64_t	chunk_time_us;	// record time relative to capture start
+	uint64_t	start_us;		// monotonic time the replay started
+	bool		eof;
+} _replay_state_t;
+
+static bool _replay_open(uart_transport_t *transport)
+{
+	_replay_state_t *state = calloc(1, sizeof(_replay_state_t));
+
+	if (!state) {
+		ERR("out of memory");
+		return false;
+	}
+
+	if (!pms7003_capture_reader_open(&state->reader, transport->path)) {
+		free(state);
+		return false;
+	}
+
+	state->start_us = pms7003_capture_now_us();
+	transport->handle = state;
+	INFO("replay [%s] speed [%.2f]", transport->path, transport->speed);
+	return true;
+}
+
+static bool _replay_configure(uart_transport_t *transport, unsigned int baud_rate)
+{
+	// recorded data is replayed as is
+	return true;
+}
+
+/*
+ * microseconds until the current chunk is due, 0 if it is due now
+ */
+static uint64_t _replay_wait_us(uart_transport_t *transport, _replay_state_t *state)
+{
+	uint64_t due_us = 0;
+	uint64_t now_us = 0;
+
+	if (transport->speed <= 0.0)
+		return 0;
+
+	due_us = state->start_us + (uint64_t)(state->chunk_time_us / transport->speed);
+	now_us = pms7003_capture_now_us();
+
+	return (due_us > now_us) ? due_us - now_us : 0;
+}
+
+/*
+ * make sure a chunk is loaded, returns false at the end of the capture
+ */
+static bool _replay_load(_replay_state_t *state)
+{
+	if (state->chunk_pos < state->chunk_len)
+		return true;
+	if (state->eof)
+		return false;
+
+	state->chunk_pos = 0;
+	if (!pms7003_capture_reader_next(&state->reader, &state->chunk_time_us, state->chunk, &state->chunk_len)) {
+		INFO("replay finished, records [%lu]", state->reader.records);
+		state->chunk_len = 0;
+		state->eof = true;
+		return false;
+	}
+
+	return true;
+}
+
+static int _replay_read(uart_transport_t *transport, uint8_t *data, uint32_t length)
+{
+	_replay_state_t *state = transport->handle;
+	size_t len = 0;
+
+	if (!_replay_load(state) || _replay_wait_us(transport, state) > 0)
+		return 0;
+
+	len = state->chunk_len - state->chunk_pos;
+	if (len > length)
+		len = length;
+
+	memcpy(data, state->chunk + state->chunk_pos, len);
+	state->chunk_pos += len;
+
+	return len;
+}
+
+static int _replay_write(uart_transport_t *transport, const uint8_t *data, uint32_t length)
+{
+	// a recording does not answer, commands are dropped
+	return length;
+}
+
+static int _replay_poll(uart_transport_t *transport, int timeout_ms)
+{
+	_replay_state_t *state = transport->handle;
+	uint64_t timeout_us = (uint64_t)timeout_ms * 1000;
+	uint64_t wait_us = 0;
+
+	if (!_replay_load(state)) {
+		// silent line after the end of the capture
+		usleep(timeout_us);
+		return 0;
+	}
+
+	wait_us = _replay_wait_us(transport, state);
+	if (wait_us > timeout_us) {
+		usleep(timeout_us);
+		return 0;
+	}
+	if (wait_us > 0)
+		usleep(wait_us);
+
+	return 1;
+}
+
+static void _replay_close(uart_transport_t *transport)
+{
+	_replay_state_t *state = transport->handle;
+
+	if (state) {
+		pms7003_capture_reader_close(&state->reader);
+		free(state);
+		transport->handle = NULL;
+	}
+}
+
+static const uart_transport_ops_t replay_ops = {
+	.name = "replay",
+	.open = _replay_open,
+	.configure = _replay_configure,
+	.read = _replay_read,
+	.write = _replay_write,
+	.poll = _replay_poll,
+	.close = _replay_close,
+};
+
+bool uart_transport_replay_create(uart_transport_t *transport, const char *path, double speed)
+{
+	memset(transport, 0, sizeof(uart_transport_t));
+	transport->ops = &replay_ops;
+	transport->fd = -1;
+	transport->speed = speed;
+	snprintf(transport->path, sizeof(transport->path), "%s", path);
+
+	return true;
+}
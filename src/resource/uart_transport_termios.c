@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "resource/uart_transport.h"
+#include "log.h"
+
+/*
+ * Linux termios UART backend
+ * works on a real tty or on a pseudo-terminal, so the acquisition path
+ * can run on an ordinary Linux host against a simulated sensor
+ */
+
+static bool _termios_open(uart_transport_t *transport)
+{
+	transport->fd = open(transport->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (transport->fd < 0) {
+		ERR("tty [%s] open Failed, errno [%d]", transport->path, errno);
+		return false;
+	}
+
+	return true;
+}
+
+static speed_t _termios_speed(unsigned int baud_rate)
+{
+	switch (baud_rate) {
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+	default:
+		return B0;
+	}
+}
+
+static bool _termios_configure(uart_transport_t *transport, unsigned int baud_rate)
+{
+	struct termios tio;
+	speed_t speed = _termios_speed(baud_rate);
+
+	if (speed == B0) {
+		ERR("unsupported baud rate [%u]", baud_rate);
+		return false;
+	}
+
+	if (tcgetattr(transport->fd, &tio) != 0) {
+		ERR("tcgetattr Failed, errno [%d]", errno);
+		return false;
+	}
+
+	// raw mode, 8 data bits, no parity, 1 stop bit, no flow control
+	cfmakeraw(&tio);
+	tio.c_cflag &= ~(PARENB | CSTOPB | CSIZE | CRTSCTS);
+	tio.c_cflag |= CS8 | CLOCAL | CREAD;
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+
+	if (tcsetattr(transport->fd, TCSANOW, &tio) != 0) {
+		ERR("tcsetattr Failed, errno [%d]", errno);
+		return false;
+	}
+
+	tcflush(transport->fd, TCIFLUSH);
+	return true;
+}
+
+static int _termios_read(uart_transport_t *transport, uint8_t *data, uint32_t length)
+{
+	ssize_t ret = read(transport->fd, data, length);
+
+	transport->device_reads++;
+	// the tty is non-blocking, no data is EAGAIN and 0 is the end of file of a hung up line
+	if (ret == 0 && length > 0) {
+		ERR("tty [%s] hung up", transport->path);
+		return -1;
+	}
+	if (ret > 0)
+		return ret;
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+		return 0;
+
+	ERR("tty read failed, errno [%d]", errno);
+	return -1;
+}
+
+static int _termios_write(uart_transport_t *transport, const uint8_t *data, uint32_t length)
+{
+	ssize_t ret = write(transport->fd, data, length);
+
+	if (ret < 0) {
+		ERR("tty write failed, errno [%d]", errno);
+		return -1;
+	}
+
+	return ret;
+}
+
+static int _termios_poll(uart_transport_t *transport, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = transport->fd, .events = POLLIN };
+	int ret = poll(&pfd, 1, timeout_ms);
+
+	if (ret < 0) {
+		if (errno == EINTR)
+			return 0;
+		ERR("tty poll failed, errno [%d]", errno);
+		return -1;
+	}
+	// error or hang-up with nothing left to read
+	if (ret > 0 && !(pfd.revents & POLLIN))
+		return -1;
+
+	return ret;
+}
+
+static void _termios_close(uart_transport_t *transport)
+{
+	if (transport->fd >= 0) {
+		close(transport->fd);
+		transport->fd = -1;
+	}
+}
+
+static const uart_transport_ops_t termios_ops = {
+	.name = "termios",
+	.open = _termios_open,
+	.configure = _termios_configure,
+	.read = _termios_read,
+	.write = _termios_write,
+	.poll = _termios_poll,
+	.close = _termios_close,
+};
+
+bool uart_transport_termios_create(uart_transport_t *transport, const char *path)
+{
+	memset(transport, 0, sizeof(uart_transport_t));
+	transport->ops = &termios_ops;
+	transport->fd = -1;
+	snprintf(transport->path, sizeof(transport->path), "%s", path);
+
+	return true;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "rolling_stats.h"
+
+static const uint32_t window_span[ROLLING_WINDOW_MAX] = { 10, 60, ROLLING_HORIZON_SECONDS };
+
+void rolling_median_init(rolling_median_t *median, unsigned int size)
+{
+	memset(median, 0, sizeof(rolling_median_t));
+	if (size == 0)
+		size = 1;
+	if (size > ROLLING_MEDIAN_WINDOW)
+		size = ROLLING_MEDIAN_WINDOW;
+	median->size = size;
+}
+
+// first position in sorted[0..n) whose value is not less than value
+static unsigned int _lower_bound(const uint16_t *sorted, unsigned int n, uint16_t value)
+{
+	unsigned int lo = 0, hi = n;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		if (sorted[mid] < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void rolling_median_add(rolling_median_t *median, uint16_t value)
+{
+	unsigned int pos;
+
+	if (median->count == median->size) {
+		// the oldest sample leaves the window
+		pos = _lower_bound(median->sorted, median->count, median->ring[median->head]);
+		memmove(&median->sorted[pos], &median->sorted[pos + 1], (median->count - pos - 1) * sizeof(uint16_t));
+		median->count--;
+	}
+
+	pos = _lower_bound(median->sorted, median->count, value);
+	memmove(&median->sorted[pos + 1], &median->sorted[pos], (median->count - pos) * sizeof(uint16_t));
+	median->sorted[pos] = value;
+	median->count++;
+
+	median->ring[median->head] = value;
+	median->head = (median->head + 1) % median->size;
+}
+
+uint16_t rolling_median_get(const rolling_median_t *median)
+{
+	unsigned int n = median->count;
+
+	if (n == 0)
+		return 0;
+	if (n & 1)
+		return median->sorted[n / 2];
+	return (median->sorted[n / 2 - 1] + median->sorted[n / 2] + 1) / 2;
+}
+
+/*
+ * deviations grow walking outwards from the middle of the sorted window,
+ * merging the two walks gives them in order without sorting
+ */
+uint16_t rolling_median_mad(const rolling_median_t *median)
+{
+	unsigned int n = median->count;
+	unsigned int k, rank;
+	int left, right;
+	uint16_t med, dev = 0;
+
+	if (n == 0)
+		return 0;
+
+	med = rolling_median_get(median);
+	right = _lower_bound(median->sorted, n, med);
+	left = right - 1;
+
+	// the median of n deviations is the (n / 2)th smallest, upper one for even n
+	rank = n / 2;
+	for (k = 0; k <= rank; k++) {
+		if (left < 0 || (right < (int)n && median->sorted[right] - med <= med - median->sorted[left])) {
+			dev = median->sorted[right] - med;
+			right++;
+		} else {
+			dev = med - median->sorted[left];
+			left--;
+		}
+	}
+	return dev;
+}
+
+void rolling_stats_init(rolling_stats_t *stats)
+{
+	memset(stats, 0, sizeof(rolling_stats_t));
+	rolling_median_init(&stats->median, ROLLING_MEDIAN_WINDOW);
+}
+
+/*
+ * move the clock to now_sec, every second passed drops out of the windows
+ * a gap longer than the horizon empties them all
+ */
+static void _advance(rolling_stats_t *stats, uint32_t now_sec)
+{
+	uint32_t sec;
+	int i;
+
+	if (now_sec - stats->last_sec >= ROLLING_HORIZON_SECONDS) {
+		memset(stats->bucket, 0, sizeof(stats->bucket));
+		memset(stats->window, 0, sizeof(stats->window));
+		stats->last_sec = now_sec;
+		return;
+	}
+
+	for (sec = stats->last_sec + 1; sec != now_sec + 1; sec++) {
+		for (i = 0; i < ROLLING_WINDOW_MAX; i++) {
+			// bucket of sec - span, still in the ring since span <= horizon
+			const rolling_bucket_t *old = &stats->bucket[(sec - window_span[i]) % ROLLING_HORIZON_SECONDS];
+			stats->window[i].sum -= old->sum;
+			stats->window[i].count -= old->count;
+		}
+		memset(&stats->bucket[sec % ROLLING_HORIZON_SECONDS], 0, sizeof(rolling_bucket_t));
+	}
+	stats->last_sec = now_sec;
+}
+
+void rolling_stats_add(rolling_stats_t *stats, uint32_t now_sec, uint16_t value)
+{
+	rolling_bucket_t *bucket;
+	int i;
+
+	if (stats->samples == 0) {
+		stats->last_sec = now_sec;
+		stats->ewma = (uint32_t)value << 8;
+	} else {
+		// a clock going backwards is folded into the current second
+		if ((int32_t)(now_sec - stats->last_sec) > 0)
+			_advance(stats, now_sec);
+		// ewma += (value - ewma) * alpha
+		stats->ewma = stats->ewma - (stats->ewma >> ROLLING_EWMA_SHIFT) + (((uint32_t)value << 8) >> ROLLING_EWMA_SHIFT);
+	}
+	stats->samples++;
+
+	bucket = &stats->bucket[stats->last_sec % ROLLING_HORIZON_SECONDS];
+	bucket->sum += value;
+	bucket->count++;
+	for (i = 0; i < ROLLING_WINDOW_MAX; i++) {
+		stats->window[i].sum += value;
+		stats->window[i].count++;
+	}
+
+	rolling_median_add(&stats->median, value);
+}
+
+void rolling_stats_get(const rolling_stats_t *stats, rolling_stats_result_t *result)
+{
+	int i;
+
+	result->ewma = (stats->ewma + 0x80) >> 8;
+	for (i = 0; i < ROLLING_WINDOW_MAX; i++) {
+		const rolling_window_t *w = &stats->window[i];
+		result->mean[i] = w->count ? (w->sum + w->count / 2) / w->count : 0;
+	}
+	result->median = rolling_median_get(&stats->median);
+	result->samples = stats->samples;
+}
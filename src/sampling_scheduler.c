@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+#include "sampling_scheduler.h"
+
+#define DEFAULT_MIN_INTERVAL	1
+#define DEFAULT_MAX_INTERVAL	60
+#define DEFAULT_ABS_BAND		3
+#define DEFAULT_REL_BAND		15
+#define DEFAULT_WARMUP			30	// PMS7003 : stable data 30 seconds after wake up
+
+#define VARIANCE_SHIFT			2	// variance EWMA alpha = 1/4
+#define VARIANCE_SCALE			4	// variance kept << 4
+#define DEVIATION_MAX			4095	// ug/m3, keeps the squared deviation in 32 bits
+
+void sampling_scheduler_config_default(sampling_scheduler_config_t *config)
+{
+	config->min_interval = DEFAULT_MIN_INTERVAL;
+	config->max_interval = DEFAULT_MAX_INTERVAL;
+	config->abs_band = DEFAULT_ABS_BAND;
+	config->rel_band = DEFAULT_REL_BAND;
+	config->warmup = DEFAULT_WARMUP;
+}
+
+static const config_spec_option_t sampling_options[] = {
+	CONFIG_SPEC_OPTION("min", config_spec_uint, sampling_scheduler_config_t, min_interval),
+	CONFIG_SPEC_OPTION("max", config_spec_uint, sampling_scheduler_config_t, max_interval),
+	CONFIG_SPEC_OPTION("abs", config_spec_uint, sampling_scheduler_config_t, abs_band),
+	CONFIG_SPEC_OPTION("rel", config_spec_uint, sampling_scheduler_config_t, rel_band),
+	CONFIG_SPEC_OPTION("sleep", config_spec_uint, sampling_scheduler_config_t, warmup),
+};
+
+bool sampling_scheduler_parse_config(const char *spec, sampling_scheduler_config_t *config)
+{
+	bool ret;
+
+	sampling_scheduler_config_default(config);
+	ret = config_spec_parse(spec, "sampling", sampling_options, sizeof(sampling_options) / sizeof(sampling_options[0]), config);
+
+	if (config->min_interval == 0)
+		config->min_interval = 1;
+	if (config->max_interval < config->min_interval)
+		config->max_interval = config->min_interval;
+
+	return ret;
+}
+
+void sampling_scheduler_init(sampling_scheduler_t *sched, const sampling_scheduler_config_t *config)
+{
+	memset(sched, 0, sizeof(sampling_scheduler_t));
+	sched->config = *config;
+	sched->interval = config->min_interval;
+}
+
+static uint32_t _diff(uint32_t a, uint32_t b)
+{
+	return (a > b) ? a - b : b - a;
+}
+
+unsigned int sampling_scheduler_update(sampling_scheduler_t *sched, uint32_t value, uint32_t baseline)
+{
+	const sampling_scheduler_config_t *config = &sched->config;
+	uint32_t band = baseline * config->rel_band / 100;
+	uint32_t dev = _diff(value, baseline);
+	uint32_t dev2 = (dev > DEVIATION_MAX ? DEVIATION_MAX : dev);
+	bool stable;
+
+	if (band < config->abs_band)
+		band = config->abs_band;
+
+	// variance += (dev^2 - variance) * alpha
+	dev2 = (dev2 * dev2) << VARIANCE_SCALE;
+	if (dev2 >= sched->variance)
+		sched->variance += (dev2 - sched->variance) >> VARIANCE_SHIFT;
+	else
+		sched->variance -= (sched->variance - dev2) >> VARIANCE_SHIFT;
+
+	stable = sched->has_prev
+			&& _diff(value, sched->prev) <= band
+			&& dev <= band
+			&& (uint64_t)(sched->variance >> VARIANCE_SCALE) <= (uint64_t)band * band;
+
+	sched->prev = value;
+	sched->has_prev = true;
+
+	if (!stable) {
+		if (sched->interval != config->min_interval)
+			sched->stats.speedups++;
+		sched->interval = config->min_interval;
+	} else if (sched->interval < config->max_interval) {
+		sched->interval *= 2;
+		if (sched->interval > config->max_interval)
+			sched->interval = config->max_interval;
+		sched->stats.slowdowns++;
+	}
+
+	return sched->interval;
+}
+
+void sampling_scheduler_get_stats(const sampling_scheduler_t *sched, sampling_scheduler_stats_t *stats)
+{
+	*stats = sched->stats;
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2018 Samsung Electronics Co., Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "log.h"
+#include "config_spec.h"
+#include "sensor_fusion.h"
+
+#define DEFAULT_STALE_MS		5000	// about two stable mode periods of the PMS7003
+#define DEFAULT_BAND			5
+#define DEFAULT_EXCLUDE			15
+#define DEFAULT_ERRORS			200
+
+#define EWMA_SHIFT				3		// disagreement alpha = 1/8
+#define ERROR_RATE_SHIFT		5		// error rate alpha = 1/32, a single bad frame is not a trend
+#define DISAGREEMENT_SCALE		4		// disagreement kept << 4
+#define DEVIATION_MAX			4095	// ug/m3, keeps the scaled disagreement in 32 bits
+#define FIELD_PM2_5				1		// index of the standard PM2.5 in the field values
+#define HEALTHY_MIN				2		// other healthy sensors needed to leave one out
+
+void sensor_fusion_config_default(sensor_fusion_config_t *config)
+{
+	config->enabled = true;
+	config->method = SENSOR_FUSION_MEDIAN;
+	config->stale_ms = DEFAULT_STALE_MS;
+	config->band = DEFAULT_BAND;
+	config->exclude = DEFAULT_EXCLUDE;
+	config->errors = DEFAULT_ERRORS;
+}
+
+static bool _parse_method(void *field, const char *value)
+{
+	if (0 == strcmp(value, "median"))
+		*(sensor_fusion_method_e *)field = SENSOR_FUSION_MEDIAN;
+	else if (0 == strcmp(value, "weighted"))
+		*(sensor_fusion_method_e *)field = SENSOR_FUSION_WEIGHTED;
+	else
+		return false;
+	return true;
+}
+
+static bool _parse_band(void *field, const char *value)
+{
+	unsigned int band = 0;
+
+	if (!config_spec_uint(&band, value) || band == 0)
+		return false;
+
+	*(unsigned int *)field = band;
+	return true;
+}
+
+static const config_spec_option_t fusion_options[] = {
+	CONFIG_SPEC_OPTION("method", _parse_method, sensor_fusion_config_t, method),
+	CONFIG_SPEC_OPTION("stale", config_spec_uint, sensor_fusion_config_t, stale_ms),
+	CONFIG_SPEC_OPTION("band", _parse_band, sensor_fusion_config_t, band),
+	CONFIG_SPEC_OPTION("exclude", config_spec_uint, sensor_fusion_config_t, exclude),
+	CONFIG_SPEC_OPTION("errors", config_spec_uint, sensor_fusion_config_t, errors),
+	CONFIG_SPEC_OPTION("off", config_spec_off, sensor_fusion_config_t, enabled),
+};
+
+bool sensor_fusion_parse_config(const char *spec, sensor_fusion_config_t *config)
+{
+	sensor_fusion_config_default(config);
+	return config_spec_parse(spec, "fusion", fusion_options, sizeof(fusion_options) / sizeof(fusion_options[0]), config);
+}
+
+void sensor_fusion_init(sensor_fusion_t *fusion, int n_sensors, const sensor_fusion_config_t *config)
+{
+	memset(fusion, 0, sizeof(sensor_fusion_t));
+	fusion->config = *config;
+	fusion->n_sensors = (n_sensors > PMS7003_SENSOR_MAX) ? PMS7003_SENSOR_MAX : n_sensors;
+}
+
+static void _get_values(const _pms7003_protocol_t *frame, uint16_t *values)
+{
+	values[0] = frame->standard_particle.PM1_0;
+	values[1] = frame->standard_particle.PM2_5;
+	values[2] = frame->standard_particle.PM10;
+	values[3] = frame->atmospheric_env.PM1_0;
+	values[4] = frame->atmospheric_env.PM2_5;
+	values[5] = frame->atmospheric_env.PM10;
+	values[6] = frame->particle_count.PC0_3;
+	values[7] = frame->particle_count.PC0_5;
+	values[8] = frame->particle_count.PC1_0;
+	values[9] = frame->particle_count.PC2_5;
+	values[10] = frame->particle_count.PC5_0;
+	values[11] = frame->particle_count.PC10;
+}
+
+static void _set_values(_pms7003_protocol_t *frame, const uint16_t *values)
+{
+	frame->standard_particle.PM1_0 = values[0];
+	frame->standard_particle.PM2_5 = values[1];
+	frame->standard_particle.PM10 = values[2];
+	frame->atmospheric_env.PM1_0 = values[3];
+	frame->atmospheric_env.PM2_5 = values[4];
+	frame->atmospheric_env.PM10 = values[5];
+	frame->particle_count.PC0_3 = values[6];
+	frame->particle_count.PC0_5 = values[7];
+	frame->particle_count.PC1_0 = values[8];
+	frame->particle_count.PC2_5 = values[9];
+	frame->particle_count.PC5_0 = values[10];
+	frame->particle_count.PC10 = values[11];
+}
+
+static bool _is_current(const sensor_fusion_t *fusion, const sensor_fusion_sensor_t *s, uint64_t now_ms)
+{
+	if (s->arrival_ms == 0)
+		return false;
+	return s->arrival_ms >= now_ms || now_ms - s->arrival_ms <= fusion->config.stale_ms;
+}
+
+// median of n (1 ~ PMS7003_SENSOR_MAX) values, the mean of the middle two for an even n
+static uint16_t _median(uint16_t *v, int n)
+{
+	int i, j;
+
+	for (i = 1; i < n; i++) {
+		uint16_t x = v[i];
+		for (j = i; j > 0 && v[j - 1] > x; j--)
+			v[j] = v[j - 1];
+		v[j] = x;
+	}
+	if (n & 1)
+		return v[n / 2];
+	return (uint16_t)(((uint32_t)v[n / 2 - 1] + v[n / 2] + 1) / 2);
+}
+
+// bit N set : sensor N is current at now_ms, healthy_only leaves out the excluded ones
+static uint32_t _current_mask(const sensor_fusion_t *fusion, uint64_t now_ms, bool healthy_only)
+{
+	uint32_t mask = 0;
+	int i;
+
+	for (i = 0; i < fusion->n_sensors; i++) {
+		const sensor_fusion_sensor_t *s = &fusion->sensors[i];
+		if (_is_current(fusion, s, now_ms) && !(healthy_only && s->excluded))
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+static int _count(uint32_t mask)
+{
+	return __builtin_popcount(mask);
+}
+
+static uint32_t _ewma(uint32_t average, uint32_t sample, int shift)
+{
+	if (sample >= average)
+		return average + ((sample - average) >> shift);
+	return average - ((average - sample) >> shift);
+}
+
+static void _update_quality(sensor_fusion_t *fusion, int sensor, unsigned long frames, unsigned long checksum_errors)
+{
+	sensor_fusion_sensor_t *s = &fusion->sensors[sensor];
+
+	// share of the frame candidates since the previous reading that failed the checksum
+	if (s->arrival_ms != 0) {
+		unsigned long good = frames - s->frames;
+		unsigned long bad = checksum_errors - s->checksum_errors;
+		uint32_t rate = (good + bad) ? (uint32_t)(bad * 1000 / (good + bad)) : 0;
+
+		s->error_rate = _ewma(s->error_rate, rate, ERROR_RATE_SHIFT);
+	}
+	s->frames = frames;
+	s->checksum_errors = checksum_errors;
+}
+
+static void _update_disagreement(sensor_fusion_t *fusion, int sensor, uint32_t current)
+{
+	sensor_fusion_sensor_t *s = &fusion->sensors[sensor];
+	const sensor_fusion_config_t *config = &fusion->config;
+	uint16_t v[PMS7003_SENSOR_MAX];
+	uint32_t dev, healthy_others;
+	bool bad;
+	int i, n = 0;
+
+	// distance to the median of every current reading, a drifting sensor is the odd one out
+	for (i = 0; i < fusion->n_sensors; i++) {
+		if (current & (1u << i))
+			v[n++] = fusion->sensors[i].values[FIELD_PM2_5];
+	}
+	if (n < 2)
+		return;
+
+	dev = abs((int)s->values[FIELD_PM2_5] - (int)_median(v, n));
+	if (dev > DEVIATION_MAX)
+		dev = DEVIATION_MAX;
+	s->disagreement = _ewma(s->disagreement, dev << DISAGREEMENT_SCALE, EWMA_SHIFT);
+
+	bad = (s->disagreement >> DISAGREEMENT_SCALE) > config->exclude || s->error_rate > config->errors;
+	healthy_others = 0;
+	for (i = 0; i < fusion->n_sensors; i++) {
+		if (i != sensor && (current & (1u << i)) && !fusion->sensors[i].excluded)
+			healthy_others++;
+	}
+
+	if (!s->excluded && bad && healthy_others >= HEALTHY_MIN) {
+		s->excluded = true;
+		fusion->stats.exclusions++;
+		WARN("sensor [%d] left out of the fusion, disagreement [%u] ug/m3, checksum errors [%u] permille",
+				sensor, s->disagreement >> DISAGREEMENT_SCALE, s->error_rate);
+	} else if (s->excluded && (s->disagreement >> DISAGREEMENT_SCALE) < config->exclude / 2
+			&& s->error_rate <= config->errors / 2) {
+		s->excluded = false;
+		fusion->stats.inclusions++;
+		INFO("sensor [%d] back in the fusion", sensor);
+	}
+}
+
+static void _fuse(const sensor_fusion_t *fusion, uint32_t mask, uint16_t *fused)
+{
+	const sensor_fusion_config_t *config = &fusion->config;
+	uint16_t v[PMS7003_SENSOR_MAX];
+	uint64_t weight[PMS7003_SENSOR_MAX];
+	uint64_t total = 0;
+	int f, i, n;
+
+	if (config->method == SENSOR_FUSION_WEIGHTED) {
+		for (i = 0; i < fusion->n_sensors; i++) {
+			const sensor_fusion_sensor_t *s = &fusion->sensors[i];
+
+			weight[i] = 0;
+			if (!(mask & (1u << i)))
+				continue;
+			// 1 / ((1 + 10 * errors / 1000) * (band + disagreement)), disagreement << 4
+			weight[i] = (1ULL << 40) / ((uint64_t)(1000 + 10 * s->error_rate)
+					* ((config->band << DISAGREEMENT_SCALE) + s->disagreement));
+			if (weight[i] == 0)
+				weight[i] = 1;
+			total += weight[i];
+		}
+	}
+
+	for (f = 0; f < SENSOR_FUSION_FIELDS; f++) {
+		if (config->method == SENSOR_FUSION_WEIGHTED) {
+			uint64_t sum = 0;
+
+			for (i = 0; i < fusion->n_sensors; i++)
+				sum += weight[i] * fusion->sensors[i].values[f];
+			fused[f] = (uint16_t)((sum + total / 2) / total);
+			continue;
+		}
+
+		for (i = 0, n = 0; i < fusion->n_sensors; i++) {
+			if (mask & (1u << i))
+				v[n++] = fusion->sensors[i].values[f];
+		}
+		fused[f] = _median(v, n);
+	}
+}
+
+bool sensor_fusion_update(sensor_fusion_t *fusion, int sensor, const _pms7003_protocol_t *frame,
+		unsigned long frames, unsigned long checksum_errors, _pms7003_protocol_t *fused)
+{
+	sensor_fusion_sensor_t *s;
+	uint64_t now_ms = frame->arrival_ms;
+	uint32_t bit = 1u << sensor;
+	uint32_t current, used;
+	uint16_t values[SENSOR_FUSION_FIELDS];
+	bool due = false;
+
+	if (sensor < 0 || sensor >= fusion->n_sensors)
+		return false;
+
+	s = &fusion->sensors[sensor];
+	_update_quality(fusion, sensor, frames, checksum_errors);
+	_get_values(frame, s->values);
+	s->arrival_ms = now_ms;
+
+	current = _current_mask(fusion, now_ms, false);
+	_update_disagreement(fusion, sensor, current);
+
+	// the healthy current sensors, all current ones if none of them is healthy
+	used = _current_mask(fusion, now_ms, true);
+	if (used == 0)
+		used = current;
+	if (!(used & bit))
+		return false;
+
+	if (fusion->reported & bit) {
+		// this sensor reported twice, do not wait for the slower ones
+		due = true;
+		fusion->reported = bit;
+	} else {
+		fusion->reported |= bit;
+		if ((fusion->reported & used) == used) {
+			due = true;
+			fusion->reported = 0;
+		}
+	}
+	if (!due)
+		return false;
+
+	_fuse(fusion, used, values);
+	*fused = *frame;
+	_set_values(fused, values);
+	fusion->stats.fused++;
+
+	DBG("fused PM2.5 [%u] from [%d] sensors", values[FIELD_PM2_5], _count(used));
+	return true;
+}
+
+bool sensor_fusion_is_used(const sensor_fusion_t *fusion, int sensor, uint64_t now_ms)
+{
+	if (sensor < 0 || sensor >= fusion->n_sensors)
+		return false;
+	return _is_current(fusion, &fusion->sensors[sensor], now_ms) && !fusion->sensors[sensor].excluded;
+}
+
+void sensor_fusion_get_stats(const sensor_fusion_t *fusion, sensor_fusion_stats_t *stats)
+{
+	*stats = fusion->stats;
+}